@@ -0,0 +1,70 @@
+// Bounded edit distance against a plain dynamic-programming Damerau
+// distance: checks they agree on random pairs, then times both and a full
+// check_answer().
+#include "../main.cpp"
+
+// Optimal string alignment distance, the reference for the kernel
+size_t naive_distance(u32string_view a, u32string_view b) {
+    vector<size_t> before(a.size() + 1), prev(a.size() + 1), cur(a.size() + 1);
+    for (size_t i = 0; i <= a.size(); i++) prev[i] = i;
+    for (size_t j = 1; j <= b.size(); j++) {
+        cur[0] = j;
+        for (size_t i = 1; i <= a.size(); i++) {
+            cur[i] = min({prev[i - 1] + (a[i - 1] == b[j - 1] ? 0 : 1), prev[i] + 1, cur[i - 1] + 1});
+            if (i > 1 && j > 1 && a[i - 1] == b[j - 2] && a[i - 2] == b[j - 1]) cur[i] = min(cur[i], before[i - 2] + 1);
+        }
+        before = prev;
+        swap(prev, cur);
+    }
+    return prev[a.size()];
+}
+
+int main() {
+    mt19937 rng(1);
+    auto random_word = [&](size_t len, int alphabet) {
+        u32string s;
+        for (size_t i = 0; i < len; i++) s += (char32_t)(rng() % 3 == 0 ? 0xE9 + rng() % alphabet : 'a' + rng() % alphabet);
+        return s;
+    };
+    // Mostly small edits of one word, some unrelated pairs, across the
+    // 64-character boundary where the kernel switches to a banded DP
+    size_t mismatches = 0;
+    for (int it = 0; it < 200000; it++) {
+        int alphabet = 2 + rng() % 5;
+        u32string a = random_word(rng() % 90, alphabet), b = a;
+        if (rng() % 2) {
+            b = random_word(rng() % 90, alphabet);
+        } else {
+            for (int e = rng() % 5; e > 0; e--) {
+                size_t p = b.empty() ? 0 : rng() % b.size();
+                int op = rng() % 3;
+                if (op == 0) b.insert(b.begin() + p, (char32_t)('a' + rng() % alphabet));
+                else if (!b.empty() && op == 1) b.erase(b.begin() + p);
+                else if (p + 1 < b.size()) swap(b[p], b[p + 1]);
+            }
+        }
+        size_t k = rng() % 6, d = naive_distance(a, b);
+        if (bounded_edit_distance(a, b, k) != min(d, k + 1)) mismatches++;
+    }
+    cout << "200000 random pairs, " << mismatches << " disagreements with the reference\n";
+
+    vector<pair<u32string, u32string>> pairs;
+    for (int i = 0; i < 10000; i++) {
+        u32string a = random_word(4 + rng() % 12, 26), b = a;
+        b[rng() % b.size()] = 'x';
+        if (rng() % 2) b += 'q';
+        pairs.emplace_back(a, b);
+    }
+    volatile size_t sink = 0;
+    auto t0 = steady_clock::now();
+    for (int r = 0; r < 100; r++) for (auto& p : pairs) sink = sink + bounded_edit_distance(p.first, p.second, 2);
+    auto t1 = steady_clock::now();
+    for (int r = 0; r < 100; r++) for (auto& p : pairs) sink = sink + naive_distance(p.first, p.second);
+    auto t2 = steady_clock::now();
+    for (int r = 0; r < 1000000; r++) sink = sink + check_answer("gracais", "gracias", -1).distance;
+    auto t3 = steady_clock::now();
+    cout << fixed << setprecision(1) << "bounded_edit_distance " << duration<double, nano>(t1 - t0).count() / 1e6
+         << " ns/pair, naive DP " << duration<double, nano>(t2 - t1).count() / 1e6 << " ns/pair, check_answer "
+         << duration<double, nano>(t3 - t2).count() / 1e6 << " ns\n";
+    return mismatches ? 1 : 0;
+}
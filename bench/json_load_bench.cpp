@@ -0,0 +1,50 @@
+// Deck loading throughput: writes a generated decks.json of about
+// VOCALO_BENCH_MB megabytes (default 100) and times load_decks() on it.
+#include "../main.cpp"
+
+int main() {
+    const char* mb_env = getenv("VOCALO_BENCH_MB");
+    const size_t target = (mb_env ? (size_t)atoll(mb_env) : 100) * 1024 * 1024;
+    Tenant t;
+    t.dir = fs::temp_directory_path() / ("vocalo_json_bench_" + to_string(getpid()));
+    fs::create_directories(t.dir);
+
+    // Words with escapes, accents and braces in the text, as real decks have
+    mt19937 rng(1);
+    string json = "{";
+    size_t words = 0;
+    for (int d = 0; json.size() < target; d++) {
+        Deck deck;
+        deck.name = "Deck \"" + to_string(d) + "\"";
+        deck.description = "Generated {benchmark} deck";
+        vector<WordFields> fields;
+        for (int i = 0; i < 1000; i++) {
+            string n = to_string(rng() % 1000000);
+            fields.push_back({"palabra" + n, "word " + n, "a definition with {braces} and \"quotes\" " + n,
+                              "¿Dónde está la palabra" + n + "?\tTab", i % 7 ? "" : "hint " + n});
+        }
+        pack_words(deck, fields);
+        words += deck.words.size();
+        if (d > 0) json += ',';
+        json += "\"deck_" + to_string(d) + "\":";
+        append_deck_json(json, deck);
+    }
+    json += '}';
+    if (!write_file_atomic(get_decks_file(t), json)) {
+        cout << "cannot write " << get_decks_file(t) << "\n";
+        return 1;
+    }
+
+    auto start = steady_clock::now();
+    load_decks(t);
+    double secs = duration<double>(steady_clock::now() - start).count();
+    size_t loaded = 0;
+    for (const auto& [id, deck] : t.decks) loaded += deck.words.size();
+    cout << "load_decks: " << json.size() / (1024 * 1024) << " MB, " << loaded << "/" << words << " words in "
+         << fixed << setprecision(0) << secs * 1000 << " ms (" << json.size() / secs / (1024 * 1024)
+         << " MB/s, including the /api/decks snapshot)\n";
+
+    error_code ec;
+    fs::remove_all(t.dir, ec);
+    return loaded == words ? 0 : 1;
+}
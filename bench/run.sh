@@ -0,0 +1,22 @@
+#!/bin/sh
+# Builds every bench/*_bench.cpp against main.cpp (or template.hpp) with
+# optimizations into build/bench/ and runs it. Pass names to run only
+# some: bench/run.sh json_load answer
+set -e
+cd "$(dirname "$0")/.."
+mkdir -p build/bench
+# The template bench compares against the header as it was before
+# templates were compiled to instructions, when git can provide it
+compiled=$(git log --format=%H -F --grep='Compile templates to a flat instruction list' 2>/dev/null | tail -n 1)
+if [ -n "$compiled" ] && git show "$compiled^:template.hpp" > build/bench/old_template.hpp 2>/dev/null; then
+    old_template=-DVOCALO_OLD_TEMPLATE
+else
+    old_template=
+fi
+for src in bench/*_bench.cpp; do
+    name=$(basename "$src" _bench.cpp)
+    if [ $# -gt 0 ] && ! echo " $* " | grep -q " $name "; then continue; fi
+    g++ -std=c++17 -O3 -DNDEBUG -DVOCALO_NO_MAIN $old_template -Ibuild/bench "$src" -o "build/bench/$name" -lpthread
+    echo "== $name"
+    (cd build/bench && "./$name")
+done
@@ -0,0 +1,70 @@
+// save_session() throughput and latency from VOCALO_BENCH_THREADS
+// concurrent callers (default 16), with and without --sync-sessions,
+// against the old per-request open/append/close of sessions.txt. The
+// HTTP layer is left out.
+#include "../main.cpp"
+
+struct Result {
+    double per_sec, p50_us, p99_us;
+};
+
+template <class F> Result run(size_t threads, size_t per_thread, F save) {
+    vector<vector<double>> lat(threads);
+    auto start = steady_clock::now();
+    vector<thread> pool;
+    for (size_t i = 0; i < threads; i++) {
+        pool.emplace_back([&, i] {
+            lat[i].reserve(per_thread);
+            for (size_t j = 0; j < per_thread; j++) {
+                auto t0 = steady_clock::now();
+                save(Session{1700000000000LL + (long long)j, "deck_" + to_string(i), 3, 5, 30, "quiz"});
+                lat[i].push_back(duration<double, micro>(steady_clock::now() - t0).count());
+            }
+        });
+    }
+    for (auto& th : pool) th.join();
+    double secs = duration<double>(steady_clock::now() - start).count();
+    vector<double> all;
+    for (auto& l : lat) all.insert(all.end(), l.begin(), l.end());
+    sort(all.begin(), all.end());
+    return {all.size() / secs, all[all.size() / 2], all[all.size() * 99 / 100]};
+}
+
+void report(const char* name, Result r) {
+    cout << fixed << setprecision(0) << setw(28) << left << name << right << setw(9) << r.per_sec << " saves/s  p50 "
+         << setprecision(1) << r.p50_us << " us  p99 " << r.p99_us << " us\n";
+}
+
+int main() {
+    const char* t_env = getenv("VOCALO_BENCH_THREADS");
+    const size_t threads = t_env ? (size_t)atoll(t_env) : 16;
+    fs::path root = fs::temp_directory_path() / ("vocalo_save_bench_" + to_string(getpid()));
+
+    // What save_session did before the group-commit log
+    fs::create_directories(root / "legacy");
+    mutex legacy_mutex;
+    auto legacy = [&](bool sync) {
+        return [&, sync](const Session& s) {
+            lock_guard lock(legacy_mutex);
+            FILE* f = fopen((root / "legacy" / "sessions.txt").string().c_str(), "a");
+            fprintf(f, "%lld %s %d %d %d %s\n", s.timestamp, s.deck.c_str(), s.correct, s.total, s.score, s.mode.c_str());
+            if (sync) sync_file(f);
+            fclose(f);
+        };
+    };
+    report("open/append/close", run(threads, 2000, legacy(false)));
+    report("open/append/fsync/close", run(threads, 200, legacy(true)));
+
+    for (bool sync : {false, true}) {
+        Tenant t;
+        t.dir = root / (sync ? "sync" : "async");
+        fs::create_directories(t.dir);
+        sync_sessions = sync;
+        open_session_log(t);
+        report(sync ? "group commit, synced" : "group commit", run(threads, sync ? 200 : 2000, [&](const Session& s) { save_session(t, s); }));
+    }
+
+    error_code ec;
+    fs::remove_all(root, ec);
+    return 0;
+}
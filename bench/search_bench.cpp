@@ -0,0 +1,74 @@
+// Search latency on a generated tenant of VOCALO_BENCH_WORDS words (default
+// 1M) in decks of 1000: builds a SearchIndex and reports p50/p99 for
+// prefix completions, exact words and misspelled words.
+#include "../main.cpp"
+
+int main() {
+    const char* n_env = getenv("VOCALO_BENCH_WORDS");
+    const size_t n = n_env ? (size_t)atoll(n_env) : 1000000;
+    mt19937 rng(1);
+    // Pronounceable words of consonant-vowel syllables, some accented, so
+    // folding and trigrams see text shaped like a vocabulary list rather
+    // than uniform noise
+    static const char* consonants[] = {"b", "c", "d", "f", "g", "h", "j", "k", "l", "m", "n",
+                                       "ñ", "p", "qu", "r", "s", "t", "v", "w", "x", "z", "ch"};
+    static const char* vowels[] = {"a", "e", "i", "o", "u", "á", "é", "í"};
+    auto random_word = [&](size_t parts) {
+        string s;
+        for (size_t i = 0; i < parts; i++) {
+            s += consonants[rng() % size(consonants)];
+            s += vowels[rng() % size(vowels)];
+        }
+        if (rng() % 2) s += consonants[rng() % size(consonants)];
+        return s;
+    };
+
+    map<string, Deck> decks;
+    vector<string> words;
+    words.reserve(n);
+    vector<WordFields> fields;
+    for (size_t i = 0; i < n; i++) {
+        WordFields& w = fields.emplace_back();
+        w.word = random_word(2 + rng() % 3);
+        w.translation = random_word(2 + rng() % 2);
+        w.definition = random_word(2) + " " + random_word(3) + " " + random_word(2);
+        words.push_back(w.word);
+        if (fields.size() == 1000 || i + 1 == n) {
+            pack_words(decks["deck_" + to_string(i / 1000)], fields);
+            fields.clear();
+        }
+    }
+
+    SearchIndex index;
+    auto start = steady_clock::now();
+    index.build(decks);
+    double build_ms = duration<double, milli>(steady_clock::now() - start).count();
+    cout << n << " words: build " << fixed << setprecision(0) << build_ms << " ms, "
+         << index.memory() / (1024 * 1024) << " MB\n";
+
+    auto run = [&](const char* name, const function<string()>& next_query) {
+        vector<double> us;
+        size_t hits = 0;
+        for (int i = 0; i < 2000; i++) {
+            string q = next_query();
+            auto t0 = steady_clock::now();
+            hits += index.search(q, 20).size();
+            us.push_back(duration<double, micro>(steady_clock::now() - t0).count());
+        }
+        sort(us.begin(), us.end());
+        cout << setw(8) << left << name << right << setprecision(1) << " p50 " << us[us.size() / 2] << " us  p99 "
+             << us[us.size() * 99 / 100] << " us  (" << setprecision(1) << (double)hits / us.size() << " hits)\n";
+    };
+    run("prefix", [&] {
+        const string& w = words[rng() % words.size()];
+        return w.substr(0, 1 + rng() % min<size_t>(4, w.size()));
+    });
+    run("exact", [&] { return words[rng() % words.size()]; });
+    run("typo", [&] {
+        string w = words[rng() % words.size()];
+        size_t p = rng() % w.size();
+        if (w[p] & 0x80) return w;  // keep accented letters whole
+        w[p] = w[p] == 'x' ? 'y' : 'x';
+        return w;
+    });
+}
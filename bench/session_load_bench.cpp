@@ -0,0 +1,60 @@
+// Session log startup at VOCALO_BENCH_SESSIONS sessions (default 1M): the
+// legacy text parse against the binary block decode and the full
+// load_sessions() with its indexes and stats.
+#include "../main.cpp"
+
+template <class F> double time_ms(F f) {
+    auto start = steady_clock::now();
+    f();
+    return duration<double, milli>(steady_clock::now() - start).count();
+}
+
+int main() {
+    const char* n_env = getenv("VOCALO_BENCH_SESSIONS");
+    const size_t n = n_env ? (size_t)atoll(n_env) : 1000000;
+    Tenant t;
+    t.dir = fs::temp_directory_path() / ("vocalo_session_bench_" + to_string(getpid()));
+    fs::create_directories(t.dir);
+
+    vector<Session> sessions(n);
+    long long ts = 1700000000000LL;
+    const char* modes[] = {"flashcard", "type", "quiz"};
+    for (size_t i = 0; i < n; i++) {
+        ts += 1000 + i % 5000;
+        sessions[i] = {ts, "deck_" + to_string(i % 50), (int)(i % 20), 20, (int)(i % 20) * 10, modes[i % 3]};
+    }
+    ostringstream text;
+    string payload, bin;
+    for (size_t i = 0; i < n; i++) {
+        const Session& s = sessions[i];
+        text << s.timestamp << " " << s.deck << " " << s.correct << " " << s.total << " " << s.score << " " << s.mode << "\n";
+        append_session_record(payload, s);
+        if ((i + 1) % 4096 == 0 || i + 1 == n) {
+            bin += make_session_block(payload, (uint32_t)((i % 4096) + 1));
+            payload.clear();
+        }
+    }
+    write_file_atomic(get_sessions_file(t), text.str());
+    write_file_atomic(get_sessions_bin_file(t), bin);
+
+    size_t got_text = 0, got_bin = 0;
+    double text_ms = time_ms([&] { got_text = read_sessions_text(get_sessions_file(t)).size(); });
+    double bin_ms = time_ms([&] {
+        MappedFile mf;
+        vector<Session> out;
+        out.reserve(mf.open(get_sessions_bin_file(t)) ? mf.size() / 32 : 0);
+        read_session_blocks(mf.data(), mf.size(), out);
+        got_bin = out.size();
+    });
+    fs::remove(get_sessions_file(t));
+    streambuf* quiet = cout.rdbuf(nullptr);
+    double load_ms = time_ms([&] { load_sessions(t); });
+    cout.rdbuf(quiet);
+
+    cout << fixed << setprecision(0) << n << " sessions: text parse " << text_ms << " ms, binary decode " << bin_ms
+         << " ms, load_sessions (with indexes and stats) " << load_ms << " ms\n";
+
+    error_code ec;
+    fs::remove_all(t.dir, ec);
+    return got_text == n && got_bin == n && t.sessions.size() == n ? 0 : 1;
+}
@@ -0,0 +1,78 @@
+// Render time of a 200-row report page. bench/run.sh also builds it
+// against the header from before templates were compiled to instructions
+// (VOCALO_OLD_TEMPLATE) and compares the two.
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <cctype>
+#include <chrono>
+#include <algorithm>
+#include <sstream>
+#include <functional>
+#include <fstream>
+#include <iomanip>
+#include <ctime>
+#include <cstdint>
+#ifdef VOCALO_OLD_TEMPLATE
+namespace old {
+#include "old_template.hpp"
+}
+#endif
+#include "../template.hpp"
+
+const char* page = R"(<html><head><title>{{ title|escape }}</title></head><body>
+<h1>Report for {{ user|capitalize }}</h1>
+{% if streak > 3 %}<p class="streak">{{ streak }} day streak!</p>{% else %}<p>Keep going</p>{% endif %}
+<table>
+{% for w in words %}<tr class="{% if loop_even %}even{% else %}odd{% endif %}">
+  <td>{{ loop_index }}</td><td>{{ w|upper }}</td><td>{{ w|truncate 12 }}</td>
+  {% if w|length > 6 %}<td class="long">long</td>{% endif %}
+  {% for t in tags %}<span>{{ t }}</span>{% endfor %}
+</tr>
+{% endfor %}
+</table>
+{# footer #}
+<footer>{{ footer|raw }}</footer></body></html>)";
+
+template <class T> T report() {
+    T t(page);
+    t.set("title", "Weekly <report>").set("user", "alice").set("streak", "5").set("footer", "<b>vocalo</b>");
+    std::vector<std::string> words;
+    for (int i = 0; i < 200; i++) words.push_back("word" + std::to_string(i * 7919 % 100000));
+    t.setList("words", words);
+    t.setList("tags", {"noun", "a1", "food"});
+    return t;
+}
+
+template <class T> double render_us(int n) {
+    T t = report<T>();
+    size_t total = 0;
+    for (int i = 0; i < 3; i++) total += t.render().size();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; i++) total += t.render().size();
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / n;
+    if (total == 1) std::cout << "";
+    return us;
+}
+
+int main() {
+    // Both headers log every render; only the results are printed
+    std::cout.setstate(std::ios::failbit);
+    double now = render_us<Template>(2000);
+#ifdef VOCALO_OLD_TEMPLATE
+    bool same = report<old::Template>().render() == report<Template>().render();
+    double before = render_us<old::Template>(200);
+#endif
+    std::cout.clear();
+    std::cout << std::fixed << std::setprecision(0) << "200-row report: " << now << " us per render";
+#ifdef VOCALO_OLD_TEMPLATE
+    std::cout << ", token walker " << before << " us (" << std::setprecision(1) << before / now << "x)"
+              << (same ? "" : ", OUTPUT DIFFERS") << "\n";
+    return same ? 0 : 1;
+#else
+    std::cout << "\n";
+    return 0;
+#endif
+}
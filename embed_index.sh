@@ -0,0 +1,32 @@
+#!/bin/sh
+# Generates index_html.h for builds with -DVOCALO_EMBED_INDEX, embedding
+# index.html (plus gzip/brotli variants when those tools are installed)
+# into the executable.
+set -e
+cd "$(dirname "$0")"
+
+emit() {
+    echo "constexpr unsigned char $1[] = {"
+    xxd -i
+    echo "};"
+    echo "constexpr size_t $1_len = sizeof($1);"
+    echo
+}
+
+{
+    echo "// Generated by embed_index.sh from index.html, do not edit."
+    echo "#pragma once"
+    echo "#include <cstddef>"
+    echo
+    emit index_html < index.html
+    if command -v gzip > /dev/null; then
+        echo "#define INDEX_HTML_GZIP 1"
+        gzip -9 -n -c index.html | emit index_html_gzip
+    fi
+    if command -v brotli > /dev/null; then
+        echo "#define INDEX_HTML_BROTLI 1"
+        brotli -q 11 -c index.html | emit index_html_brotli
+    fi
+} > index_html.h.tmp
+mv index_html.h.tmp index_html.h
+echo "Wrote index_html.h"
@@ -1,24 +1,50 @@
 #include "httplib.h"
 #include <vector>
 #include <string>
+#include <string_view>
+#include <cstring>
 #include <random>
 #include <chrono>
 #include <algorithm>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <iomanip>
+#include <climits>
+#include <cmath>
 #include <filesystem>
 #include <thread>
 #include <cstdlib>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <list>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <cstdio>
 
 #ifdef _WIN32
     #include <windows.h>
     #include <shlobj.h>
+    #include <io.h>
 #else
     #include <unistd.h>
     #include <sys/types.h>
     #include <pwd.h>
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+#ifdef __linux__
+    #include <sys/inotify.h>
+#endif
+
+#ifdef VOCALO_EMBED_INDEX
+    #include "index_html.h"  // generated by embed_index.sh
 #endif
 
 using namespace std;
@@ -65,27 +91,658 @@ void open_browser(const string& url) {
 }
 
 // Simple JSON helpers
-string escape_json(const string& s) {
-    string out;
+void append_json_escaped(string& out, string_view s) {
     for (char c : s) {
         if (c == '"') out += "\\\"";
         else if (c == '\\') out += "\\\\";
         else if (c == '\n') out += "\\n";
+        else if (c == '\r') out += "\\r";
+        else if (c == '\t') out += "\\t";
+        else if ((unsigned char)c < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", (unsigned char)c);
+            out += buf;
+        }
         else out += c;
     }
+}
+
+string escape_json(string_view s) {
+    string out;
+    append_json_escaped(out, s);
     return out;
 }
 
-string read_file_content(const string& path) {
-    ifstream file(path);
-    if (!file.is_open()) return "<h1>Error: " + path + " not found</h1>";
-    return string((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+// Pull parser over an in-memory JSON document. Callers walk the structure
+// with begin_object/next_key and begin_array/next_element and read scalars
+// in place. Strings without escapes come back as views into the source;
+// escaped ones are decoded into a scratch buffer that is only valid until
+// the next read. Unknown values are skipped without allocating.
+class JsonReader {
+    string_view src;
+    size_t pos = 0;
+    bool failed = false;
+    string scratch;
+
+    void skip_ws() {
+        while (pos < src.size() && (src[pos] == ' ' || src[pos] == '\n' || src[pos] == '\r' || src[pos] == '\t')) pos++;
+    }
+
+    bool fail() {
+        failed = true;
+        pos = src.size();
+        return false;
+    }
+
+    static void append_utf8(string& out, uint32_t cp) {
+        if (cp < 0x80) {
+            out += (char)cp;
+        } else if (cp < 0x800) {
+            out += (char)(0xC0 | (cp >> 6));
+            out += (char)(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            out += (char)(0xE0 | (cp >> 12));
+            out += (char)(0x80 | ((cp >> 6) & 0x3F));
+            out += (char)(0x80 | (cp & 0x3F));
+        } else {
+            out += (char)(0xF0 | (cp >> 18));
+            out += (char)(0x80 | ((cp >> 12) & 0x3F));
+            out += (char)(0x80 | ((cp >> 6) & 0x3F));
+            out += (char)(0x80 | (cp & 0x3F));
+        }
+    }
+
+    bool read_hex4(uint32_t& out) {
+        if (pos + 4 > src.size()) return false;
+        out = 0;
+        for (int k = 0; k < 4; k++) {
+            char c = src[pos++];
+            out <<= 4;
+            if (c >= '0' && c <= '9') out |= c - '0';
+            else if (c >= 'a' && c <= 'f') out |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') out |= c - 'A' + 10;
+            else return false;
+        }
+        return true;
+    }
+
+    // Decodes the rest of a string whose first escape is at pos
+    bool decode_escaped(size_t start, string_view& out) {
+        scratch.assign(src.data() + start, pos - start);
+        while (pos < src.size()) {
+            char c = src[pos++];
+            if (c == '"') {
+                out = scratch;
+                return true;
+            }
+            if (c != '\\') {
+                scratch += c;
+                continue;
+            }
+            if (pos >= src.size()) break;
+            char e = src[pos++];
+            switch (e) {
+                case '"': scratch += '"'; break;
+                case '\\': scratch += '\\'; break;
+                case '/': scratch += '/'; break;
+                case 'b': scratch += '\b'; break;
+                case 'f': scratch += '\f'; break;
+                case 'n': scratch += '\n'; break;
+                case 'r': scratch += '\r'; break;
+                case 't': scratch += '\t'; break;
+                case 'u': {
+                    uint32_t cp;
+                    if (!read_hex4(cp)) return fail();
+                    if (cp >= 0xD800 && cp < 0xDC00 && pos + 1 < src.size() &&
+                        src[pos] == '\\' && src[pos + 1] == 'u') {
+                        size_t save = pos;
+                        pos += 2;
+                        uint32_t lo;
+                        if (read_hex4(lo) && lo >= 0xDC00 && lo < 0xE000) {
+                            cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                        } else {
+                            pos = save;
+                        }
+                    }
+                    append_utf8(scratch, cp);
+                    break;
+                }
+                default: scratch += e;
+            }
+        }
+        return fail();
+    }
+
+public:
+    explicit JsonReader(string_view s) : src(s) {}
+
+    bool ok() const { return !failed; }
+    size_t offset() const { return pos; }
+
+    // Next significant character, or 0 at end of input
+    char peek() {
+        skip_ws();
+        return pos < src.size() ? src[pos] : 0;
+    }
+
+    bool begin_object() {
+        if (peek() != '{') return false;
+        pos++;
+        return true;
+    }
+
+    bool begin_array() {
+        if (peek() != '[') return false;
+        pos++;
+        return true;
+    }
+
+    // Advances to the next member of the current object. Returns false once
+    // the closing brace has been consumed (or on malformed input).
+    bool next_key(string_view& key) {
+        if (failed) return false;
+        char c = peek();
+        if (c == ',') { pos++; c = peek(); }
+        if (c == '}') { pos++; return false; }
+        if (!read_string(key)) return false;
+        if (peek() != ':') return fail();
+        pos++;
+        return true;
+    }
+
+    // Advances to the next element of the current array. Returns false once
+    // the closing bracket has been consumed or the input is malformed.
+    bool next_element() {
+        if (failed) return false;
+        char c = peek();
+        if (c == ',') { pos++; c = peek(); }
+        if (c == ']') { pos++; return false; }
+        return c != 0 || fail();
+    }
+
+    bool read_string(string_view& out) {
+        if (peek() != '"') return fail();
+        size_t start = ++pos;
+        while (pos < src.size()) {
+            char c = src[pos];
+            if (c == '"') {
+                out = src.substr(start, pos - start);
+                pos++;
+                return true;
+            }
+            if (c == '\\') return decode_escaped(start, out);
+            pos++;
+        }
+        return fail();
+    }
+
+    // Reads a string value into dst; non-string values are skipped and leave dst empty
+    bool read_string(string& dst) {
+        if (peek() != '"') {
+            dst.clear();
+            skip_value();
+            return false;
+        }
+        string_view v;
+        if (!read_string(v)) return false;
+        dst.assign(v.data(), v.size());
+        return true;
+    }
+
+    // Reads an integer, saturating instead of overflowing. Fractions are truncated
+    // and quoted numbers are accepted; anything else yields 0.
+    bool read_int(long long& out) {
+        out = 0;
+        char c = peek();
+        if (c == '"') {
+            string_view v;
+            if (!read_string(v)) return false;
+            JsonReader inner(v);
+            return inner.read_int(out);
+        }
+        if (c != '-' && !(c >= '0' && c <= '9')) {
+            skip_value();
+            return false;
+        }
+        bool neg = c == '-';
+        if (neg) pos++;
+        const long long limit = 999999999999999999LL;
+        while (pos < src.size() && src[pos] >= '0' && src[pos] <= '9') {
+            if (out < limit) out = out * 10 + (src[pos] - '0');
+            pos++;
+        }
+        if (neg) out = -out;
+        while (pos < src.size() && (src[pos] == '.' || src[pos] == 'e' || src[pos] == 'E' ||
+                                    src[pos] == '+' || src[pos] == '-' || (src[pos] >= '0' && src[pos] <= '9'))) pos++;
+        return true;
+    }
+
+    bool read_int(int& out) {
+        long long v;
+        bool r = read_int(v);
+        out = (int)max<long long>(INT_MIN, min<long long>(INT_MAX, v));
+        return r;
+    }
+
+    // Skips one complete value of any type. Fails, rather than consuming
+    // nothing, where no value can start, so callers' loops always advance.
+    void skip_value() {
+        char c = peek();
+        if (c == '"') {
+            string_view v;
+            read_string(v);
+            return;
+        }
+        if (c == 0 || c == '}' || c == ']' || c == ':' || c == ',') {
+            fail();
+            return;
+        }
+        if (c != '{' && c != '[') {
+            while (pos < src.size() && src[pos] != ',' && src[pos] != '}' && src[pos] != ']' && src[pos] != ':' &&
+                   src[pos] != ' ' && src[pos] != '\n' && src[pos] != '\r' && src[pos] != '\t') pos++;
+            return;
+        }
+        int depth = 0;
+        while (pos < src.size()) {
+            char ch = src[pos++];
+            if (ch == '"') {
+                while (pos < src.size() && src[pos] != '"') pos += src[pos] == '\\' ? 2 : 1;
+                pos++;
+            } else if (ch == '{' || ch == '[') {
+                depth++;
+            } else if (ch == '}' || ch == ']') {
+                if (--depth == 0) return;
+            }
+        }
+        fail();
+    }
+};
+
+bool read_whole_file(const fs::path& path, string& out) {
+    ifstream file(path, ios::binary);
+    if (!file.is_open()) return false;
+    file.seekg(0, ios::end);
+    streamoff size = file.tellg();
+    file.seekg(0, ios::beg);
+    out.resize(size > 0 ? (size_t)size : 0);
+    if (size > 0) file.read(&out[0], size);
+    return true;
+}
+
+// Read-only view of a whole file. Uses mmap where available so the pages
+// come straight from (and are shared through) the OS page cache.
+class MappedFile {
+    const char* ptr = nullptr;
+    size_t len = 0;
+#ifdef _WIN32
+    string buffer;
+#endif
+
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() {
+#ifndef _WIN32
+        if (ptr) munmap((void*)ptr, len);
+#endif
+    }
+
+    bool open(const fs::path& path) {
+#ifdef _WIN32
+        if (!read_whole_file(path, buffer)) return false;
+        ptr = buffer.data();
+        len = buffer.size();
+        return true;
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            close(fd);
+            return false;
+        }
+        void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) return false;
+        ptr = (const char*)p;
+        len = (size_t)st.st_size;
+        return true;
+#endif
+    }
+
+    const char* data() const { return ptr; }
+    size_t size() const { return len; }
+};
+
+// Flushes stdio buffers and forces the file's data to stable storage
+bool sync_file(FILE* f) {
+    if (fflush(f) != 0) return false;
+#ifdef _WIN32
+    return _commit(_fileno(f)) == 0;
+#elif __APPLE__
+    return fsync(fileno(f)) == 0;
+#else
+    return fdatasync(fileno(f)) == 0;
+#endif
+}
+
+void sync_directory(const fs::path& dir) {
+#ifndef _WIN32
+    int fd = open(dir.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+#endif
+}
+
+// Replaces path with data so that readers see either the old or the new
+// contents, never a partial write: temp file, fsync, then rename over.
+bool write_file_atomic(const fs::path& path, const string& data) {
+    fs::path tmp = path;
+    tmp += ".tmp";
+    FILE* f = fopen(tmp.string().c_str(), "wb");
+    if (!f) return false;
+    bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+    ok = sync_file(f) && ok;
+    ok = fclose(f) == 0 && ok;
+    if (!ok) return false;
+    error_code ec;
+    fs::rename(tmp, path, ec);
+    if (ec) return false;
+    sync_directory(path.parent_path());
+    return true;
+}
+
+// 64-bit FNV-1a, used for content ETags
+uint64_t fnv1a64(string_view s) {
+    uint64_t h = 1469598103934665603ULL;
+    for (unsigned char c : s) {
+        h ^= c;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+// Non-negative integer query parameter; def when absent or not a number
+long long query_int(const httplib::Request& req, const char* key, long long def) {
+    if (!req.has_param(key)) return def;
+    const string v = req.get_param_value(key);
+    if (v.empty()) return def;
+    long long n = 0;
+    for (char c : v) {
+        if (!isdigit((unsigned char)c)) return def;
+        if (n < 999999999999999999LL) n = n * 10 + (c - '0');
+    }
+    return n;
+}
+
+// If-None-Match is "*" or a comma-separated list of entity tags. Tags are
+// compared weakly, so W/"x" matches "x", but otherwise exactly.
+bool etag_matches(const httplib::Request& req, const string& etag) {
+    if (!req.has_header("If-None-Match")) return false;
+    string inm = req.get_header_value("If-None-Match");
+    string_view tag = etag;
+    if (tag.substr(0, 2) == "W/") tag.remove_prefix(2);
+    size_t i = 0;
+    while (i < inm.size()) {
+        if (inm[i] == ' ' || inm[i] == '\t' || inm[i] == ',') {
+            i++;
+            continue;
+        }
+        if (inm[i] == '*') return true;
+        if (inm.compare(i, 2, "W/") == 0) i += 2;
+        if (i >= inm.size() || inm[i] != '"') return false;
+        size_t close = inm.find('"', i + 1);
+        if (close == string::npos) return false;
+        if (string_view(inm).substr(i, close + 1 - i) == tag) return true;
+        i = close + 1;
+    }
+    return false;
+}
+
+// ==========================================
+// Group Commit Log
+// ==========================================
+// Append-only log file. Callers append a record and get back a sequence
+// number; a writer drains everything queued since its last pass, writes
+// it in one go and syncs once, so concurrent appenders share a single
+// fsync. An optional framer turns a batch of records into the bytes
+// written (e.g. one checksummed block), and an optional capacity bounds
+// the queue, making appenders wait.
+// A batch that cannot be written whole is cut off again and reported as
+// failed to everyone waiting on it, so nothing is acknowledged that is not
+// on disk and later batches never follow a partial one.
+// Logs share a fixed set of writer threads and only hold the file open
+// while a batch is being written, so an idle log costs no thread and no
+// descriptor however many tenants are loaded.
+class GroupCommitLog;
+const size_t log_writer_threads = 4;
+
+// Writes for every GroupCommitLog. A log with records queued is scheduled
+// once and written one batch per turn, so a busy log cannot hold a writer
+// while others wait.
+class LogWriters {
+public:
+    static LogWriters& instance() {
+        // Never destroyed: logs in static storage may still drain at exit
+        static LogWriters* writers = new LogWriters(log_writer_threads);
+        return *writers;
+    }
+
+    void schedule(GroupCommitLog* log) {
+        lock_guard lock(m);
+        ready.push_back(log);
+        cv.notify_one();
+    }
+
+private:
+    mutex m;
+    condition_variable cv;
+    deque<GroupCommitLog*> ready;
+    vector<thread> threads;
+
+    explicit LogWriters(size_t n) {
+        for (size_t i = 0; i < n; i++) threads.emplace_back([this] { run(); });
+    }
+    void run();
+};
+
+class GroupCommitLog {
+public:
+    using Framer = function<void(const vector<string>& batch, string& out)>;
+
+private:
+    friend class LogWriters;
+    fs::path path;
+    bool sync = true;
+    size_t capacity = 0;
+    Framer framer;
+    mutex m;
+    mutex io_mutex;
+    condition_variable done_cv;
+    condition_variable space_cv;
+    vector<string> pending;
+    uint64_t appended = 0;
+    uint64_t durable = 0;  // every record up to here is written or failed
+    vector<pair<uint64_t, uint64_t>> failed;  // [first, last] record ranges
+    bool scheduled = false;  // queued on, or being written by, a writer
+    atomic<size_t> bytes{0};
+    bool trim = false;  // the file may hold a partial batch past bytes
+
+    // Appends buf at the end of the last good batch, trimming off whatever
+    // a failed write left behind first
+    bool write_batch(const string& buf) {
+        error_code ec;
+        if (trim && fs::exists(path, ec)) fs::resize_file(path, bytes, ec);
+        if (ec) return false;
+        trim = false;
+        FILE* file = fopen(path.string().c_str(), "ab");
+        if (!file) return false;
+        bool ok = fwrite(buf.data(), 1, buf.size(), file) == buf.size();
+        ok = ok && (sync ? sync_file(file) : fflush(file) == 0);
+        ok = fclose(file) == 0 && ok;
+        if (ok) bytes += buf.size();
+        else trim = true;
+        return ok;
+    }
+
+    // Writes one batch; true if more records are queued and the log needs
+    // another turn
+    bool write_pending() {
+        vector<string> batch;
+        uint64_t upto;
+        {
+            lock_guard lock(m);
+            batch.swap(pending);
+            upto = appended;
+            space_cv.notify_all();
+        }
+
+        string buf;
+        if (framer) framer(batch, buf);
+        else for (const auto& rec : batch) buf += rec;
+        batch.clear();
+        bool ok;
+        {
+            lock_guard io(io_mutex);
+            ok = write_batch(buf);
+        }
+        if (!ok) cout << "Warning: failed to write " << path << "\n";
+
+        lock_guard lock(m);
+        if (!ok) failed.emplace_back(durable + 1, upto);
+        durable = upto;
+        scheduled = !pending.empty();
+        done_cv.notify_all();
+        return scheduled;
+    }
+
+public:
+    GroupCommitLog() = default;
+    GroupCommitLog(const GroupCommitLog&) = delete;
+    GroupCommitLog& operator=(const GroupCommitLog&) = delete;
+
+    // Waits for queued records to be written
+    ~GroupCommitLog() {
+        unique_lock lock(m);
+        done_cv.wait(lock, [&] { return !scheduled; });
+    }
+
+    // sync=false skips the fdatasync (records still reach the OS once per batch)
+    void open(const fs::path& p, bool sync_writes = true, size_t max_pending = 0, Framer batch_framer = nullptr) {
+        path = p;
+        sync = sync_writes;
+        capacity = max_pending;
+        framer = std::move(batch_framer);
+        FILE* file = fopen(path.string().c_str(), "ab");
+        if (file) fclose(file);
+        else cout << "Warning: cannot open " << path << " for appending; writes will fail until it can be\n";
+        error_code ec;
+        auto size = fs::file_size(path, ec);
+        bytes = ec ? 0 : (size_t)size;
+    }
+
+    uint64_t append(string record) {
+        unique_lock lock(m);
+        if (capacity) space_cv.wait(lock, [&] { return pending.size() < capacity; });
+        pending.push_back(std::move(record));
+        if (!scheduled) {
+            scheduled = true;
+            LogWriters::instance().schedule(this);
+        }
+        return ++appended;
+    }
+
+    // Waits until record seq has been written; false if its batch failed
+    bool wait_durable(uint64_t seq) {
+        unique_lock lock(m);
+        done_cv.wait(lock, [&] { return durable >= seq; });
+        auto after = upper_bound(failed.begin(), failed.end(), make_pair(seq, UINT64_MAX));
+        return after == failed.begin() || prev(after)->second < seq;
+    }
+
+    // Waits until everything appended so far has been written or failed
+    void flush() {
+        uint64_t seq;
+        {
+            lock_guard lock(m);
+            seq = appended;
+        }
+        wait_durable(seq);
+    }
+
+    // Drops everything written so far. Only safe once the caller has
+    // persisted the state those records describe elsewhere.
+    void truncate() {
+        lock_guard io(io_mutex);
+        bytes = 0;
+        trim = true;
+        error_code ec;
+        fs::resize_file(path, 0, ec);
+        if (!ec) trim = false;
+    }
+
+    size_t size() const { return bytes; }
+};
+
+void LogWriters::run() {
+    unique_lock lock(m);
+    while (true) {
+        cv.wait(lock, [&] { return !ready.empty(); });
+        GroupCommitLog* log = ready.front();
+        ready.pop_front();
+        lock.unlock();
+        // The log stays alive while scheduled, and write_pending() only
+        // returns true while it still is
+        if (log->write_pending()) schedule(log);
+        lock.lock();
+    }
+}
+
+// Feeds each line of a newline-delimited journal to apply, which returns
+// false for a record it cannot parse. Such a line is skipped with a
+// warning and replay goes on, so one damaged record costs only itself. A
+// last line without its newline is a write torn by a crash; it is cut off
+// so later appends start on a line of their own. Returns the number of
+// records applied.
+size_t replay_journal(const fs::path& path, const function<bool(string_view)>& apply) {
+    string content;
+    if (!read_whole_file(path, content)) return 0;
+    size_t applied = 0, skipped = 0;
+    size_t pos = 0;
+    while (pos < content.size()) {
+        size_t eol = content.find('\n', pos);
+        if (eol == string::npos) {
+            cout << "Warning: " << path << " ends in an incomplete record, truncating it\n";
+            error_code ec;
+            fs::resize_file(path, pos, ec);
+            break;
+        }
+        if (apply(string_view(content).substr(pos, eol - pos))) applied++;
+        else skipped++;
+        pos = eol + 1;
+    }
+    if (skipped) cout << "Warning: skipped " << skipped << " damaged records in " << path << "\n";
+    return applied;
 }
 
 // ==========================================
 // Data Structures
 // ==========================================
+// A word's fields are views into text its deck keeps alive (Deck::text)
 struct Word {
+    string_view word;
+    string_view translation;
+    string_view definition;
+    string_view example;
+    string_view hint;
+};
+
+// A word that owns its text, as parsed, until pack_words() moves it into
+// a deck
+struct WordFields {
     string word;
     string translation;
     string definition;
@@ -97,8 +754,45 @@ struct Deck {
     string name;
     string description;
     vector<Word> words;
+    // What the words point into: the decks.bin mapping the deck was loaded
+    // from, or an arena of its own. It is never written to, so copies of
+    // the deck share it, and changing words means packing new ones.
+    shared_ptr<const void> text;
+    size_t text_bytes = 0;  // heap behind text; 0 for a mapping
 };
 
+// Replaces the deck's words with fields, packed into one arena
+void pack_words(Deck& deck, const vector<WordFields>& fields) {
+    size_t total = 0;
+    for (const auto& f : fields) {
+        total += f.word.size() + f.translation.size() + f.definition.size() + f.example.size() + f.hint.size();
+    }
+    auto arena = make_shared<string>();
+    arena->reserve(total);
+    for (const auto& f : fields) {
+        for (const string* s : {&f.word, &f.translation, &f.definition, &f.example, &f.hint}) *arena += *s;
+    }
+    // Views are taken once the arena is complete, so it never moves under them
+    const char* next = arena->data();
+    auto take = [&](const string& s) {
+        string_view v(next, s.size());
+        next += s.size();
+        return v;
+    };
+    deck.words.clear();
+    deck.words.reserve(fields.size());
+    for (const auto& f : fields) {
+        Word& w = deck.words.emplace_back();
+        w.word = take(f.word);
+        w.translation = take(f.translation);
+        w.definition = take(f.definition);
+        w.example = take(f.example);
+        w.hint = take(f.hint);
+    }
+    deck.text_bytes = arena->capacity();
+    deck.text = std::move(arena);
+}
+
 struct Session {
     long long timestamp;
     string deck;
@@ -108,314 +802,3423 @@ struct Session {
     string mode;
 };
 
-map<string, Deck> decks;
-vector<Session> sessions;
-
 // ==========================================
-// Persistence
+// Session Statistics
 // ==========================================
-fs::path get_decks_file() { return get_data_directory() / "decks.json"; }
-fs::path get_sessions_file() { return get_data_directory() / "sessions.txt"; }
+// Quantile sketch with 1% relative accuracy (DDSketch-style): values are
+// counted in logarithmically sized buckets, so memory grows with the
+// value range rather than with the number of samples.
+class QuantileSketch {
+    static constexpr double gamma = 1.02;
+    map<int, uint64_t> positive;
+    map<int, uint64_t> negative;
+    uint64_t zeros = 0;
+    uint64_t count = 0;
 
-void load_decks() {
-    decks.clear();
-    ifstream file(get_decks_file());
-    if (!file.is_open()) {
-        // Create sample deck
-        decks["sample"] = {
-            "Spanish Basics",
-            "Common Spanish words",
-            {
-                {"hola", "hello", "a greeting", "¡Hola! ¿Cómo estás?", ""},
-                {"gracias", "thank you", "expression of gratitude", "Muchas gracias", ""},
-                {"agua", "water", "H2O, liquid for drinking", "Quiero agua", ""},
-                {"casa", "house", "a building for living", "Mi casa es tu casa", ""},
-                {"libro", "book", "written or printed work", "Leo un libro", ""},
-                {"perro", "dog", "domesticated canine", "El perro es grande", ""},
-                {"gato", "cat", "domesticated feline", "El gato duerme", ""},
-                {"tiempo", "time/weather", "duration or atmospheric conditions", "¿Qué tiempo hace?", ""},
-                {"amigo", "friend", "a person you know and like", "Él es mi amigo", ""},
-                {"comida", "food", "something to eat", "La comida está lista", ""}
-            }
-        };
-        return;
-    }
-
-    string content((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
-    // Simple JSON parse (production would use proper library)
-    size_t pos = 0;
-    while ((pos = content.find("\"deck_", pos)) != string::npos || 
-           (pos == 0 && (pos = content.find("\"sample\"", pos)) != string::npos)) {
-        size_t idStart = pos + 1;
-        size_t idEnd = content.find("\"", idStart);
-        string id = content.substr(idStart, idEnd - idStart);
-        
-        size_t namePos = content.find("\"name\"", idEnd);
-        if (namePos == string::npos) break;
-        size_t nameStart = content.find("\"", namePos + 6) + 1;
-        size_t nameEnd = content.find("\"", nameStart);
-        string name = content.substr(nameStart, nameEnd - nameStart);
+    static int bucket(double v) { return (int)ceil(log(v) / log(gamma)); }
+    static double value(int b) { return 2 * pow(gamma, b) / (gamma + 1); }
 
-        Deck deck;
-        deck.name = name;
+public:
+    void add(double v) {
+        count++;
+        if (v > 0) positive[bucket(v)]++;
+        else if (v < 0) negative[bucket(-v)]++;
+        else zeros++;
+    }
 
-        size_t descPos = content.find("\"description\"", nameEnd);
-        if (descPos != string::npos && descPos < content.find("\"words\"", nameEnd)) {
-            size_t descStart = content.find("\"", descPos + 13) + 1;
-            size_t descEnd = content.find("\"", descStart);
-            deck.description = content.substr(descStart, descEnd - descStart);
+    double quantile(double q) const {
+        if (count == 0) return 0;
+        uint64_t rank = (uint64_t)(q * (count - 1));
+        uint64_t seen = 0;
+        for (auto it = negative.rbegin(); it != negative.rend(); ++it) {
+            seen += it->second;
+            if (seen > rank) return -value(it->first);
+        }
+        seen += zeros;
+        if (seen > rank) return 0;
+        for (const auto& [b, n] : positive) {
+            seen += n;
+            if (seen > rank) return value(b);
         }
+        return positive.empty() ? 0 : value(positive.rbegin()->first);
+    }
+};
 
-        size_t wordsStart = content.find("[", content.find("\"words\"", nameEnd));
-        size_t wordsEnd = content.find("]", wordsStart);
-        string wordsStr = content.substr(wordsStart, wordsEnd - wordsStart + 1);
+struct MetricSummary {
+    uint64_t count = 0;
+    double sum = 0;
+    double min = 0;
+    double max = 0;
+    QuantileSketch sketch;
 
-        size_t wpos = 0;
-        while ((wpos = wordsStr.find("{", wpos)) != string::npos) {
-            Word w;
-            size_t wend = wordsStr.find("}", wpos);
-            string wordObj = wordsStr.substr(wpos, wend - wpos);
+    void add(double v) {
+        if (count == 0 || v < min) min = v;
+        if (count == 0 || v > max) max = v;
+        count++;
+        sum += v;
+        sketch.add(v);
+    }
+};
 
-            auto getField = [&](const string& field) -> string {
-                size_t fp = wordObj.find("\"" + field + "\"");
-                if (fp == string::npos) return "";
-                size_t vs = wordObj.find("\"", fp + field.length() + 2) + 1;
-                size_t ve = wordObj.find("\"", vs);
-                return wordObj.substr(vs, ve - vs);
-            };
+struct SessionStats {
+    uint64_t sessions = 0;
+    long long correct = 0;
+    long long total = 0;
+    MetricSummary score;
+    MetricSummary accuracy;  // percent correct per session
 
-            w.word = getField("word");
-            w.translation = getField("translation");
-            w.definition = getField("definition");
-            w.example = getField("example");
-            w.hint = getField("hint");
+    void add(const Session& s) {
+        sessions++;
+        correct += s.correct;
+        total += s.total;
+        score.add(s.score);
+        if (s.total > 0) accuracy.add(100.0 * s.correct / s.total);
+    }
+};
 
-            if (!w.word.empty()) deck.words.push_back(w);
-            wpos = wend + 1;
-        }
+string utc_day(long long timestamp_ms) {
+    // Sessions arrive in timestamp order, so the previous answer usually fits
+    thread_local long long cached_day = LLONG_MIN;
+    thread_local string cached;
+    long long day = timestamp_ms >= 0 ? timestamp_ms / 86400000 : (timestamp_ms - 86399999) / 86400000;
+    if (day == cached_day) return cached;
+    time_t t = (time_t)(timestamp_ms / 1000);
+    struct tm tm_utc;
+#ifdef _WIN32
+    gmtime_s(&tm_utc, &t);
+#else
+    gmtime_r(&t, &tm_utc);
+#endif
+    char buf[16];
+    strftime(buf, sizeof(buf), "%Y-%m-%d", &tm_utc);
+    cached_day = day;
+    cached = buf;
+    return cached;
+}
 
-        decks[id] = deck;
-        pos = wordsEnd;
-    }
+void append_metric_json(string& json, const MetricSummary& m) {
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+             "{\"count\":%llu,\"sum\":%.6g,\"min\":%.6g,\"max\":%.6g,\"mean\":%.6g,\"p50\":%.6g,\"p90\":%.6g,\"p99\":%.6g}",
+             (unsigned long long)m.count, m.sum, m.min, m.max, m.count ? m.sum / m.count : 0.0,
+             m.sketch.quantile(0.5), m.sketch.quantile(0.9), m.sketch.quantile(0.99));
+    json += buf;
 }
 
-void save_decks() {
-    ofstream file(get_decks_file());
-    file << "{\n";
-    bool first = true;
-    for (const auto& [id, deck] : decks) {
-        if (!first) file << ",\n";
-        first = false;
-        file << "  \"" << id << "\": {\n";
-        file << "    \"name\": \"" << escape_json(deck.name) << "\",\n";
-        file << "    \"description\": \"" << escape_json(deck.description) << "\",\n";
-        file << "    \"words\": [\n";
-        for (size_t i = 0; i < deck.words.size(); i++) {
-            const auto& w = deck.words[i];
-            file << "      {\"word\": \"" << escape_json(w.word) 
-                 << "\", \"translation\": \"" << escape_json(w.translation)
-                 << "\", \"definition\": \"" << escape_json(w.definition)
-                 << "\", \"example\": \"" << escape_json(w.example)
-                 << "\", \"hint\": \"" << escape_json(w.hint) << "\"}";
-            if (i < deck.words.size() - 1) file << ",";
-            file << "\n";
-        }
-        file << "    ]\n  }";
-    }
-    file << "\n}\n";
+void append_stats_json(string& json, const SessionStats& st) {
+    json += "{\"sessions\":" + to_string(st.sessions);
+    json += ",\"correct\":" + to_string(st.correct);
+    json += ",\"total\":" + to_string(st.total);
+    json += ",\"score\":";
+    append_metric_json(json, st.score);
+    json += ",\"accuracy\":";
+    append_metric_json(json, st.accuracy);
+    json += '}';
 }
 
-void load_sessions() {
-    sessions.clear();
-    ifstream file(get_sessions_file());
-    if (!file.is_open()) return;
-    string line;
-    while (getline(file, line)) {
-        istringstream iss(line);
-        Session s;
-        if (iss >> s.timestamp >> s.deck >> s.correct >> s.total >> s.score >> s.mode) {
-            sessions.push_back(s);
-        }
+// Compact single-line JSON for one deck, shared by the snapshot and the journal
+void append_deck_json(string& json, const Deck& deck) {
+    json += "{\"name\":\""; append_json_escaped(json, deck.name); json += "\",";
+    json += "\"description\":\""; append_json_escaped(json, deck.description); json += "\",";
+    json += "\"words\":[";
+    for (size_t i = 0; i < deck.words.size(); i++) {
+        const auto& w = deck.words[i];
+        if (i > 0) json += ',';
+        json += "{\"word\":\""; append_json_escaped(json, w.word);
+        json += "\",\"translation\":\""; append_json_escaped(json, w.translation);
+        json += "\",\"definition\":\""; append_json_escaped(json, w.definition);
+        json += "\",\"example\":\""; append_json_escaped(json, w.example);
+        json += "\",\"hint\":\""; append_json_escaped(json, w.hint);
+        json += "\"}";
     }
+    json += "]}";
 }
 
-void save_session(const Session& s) {
-    sessions.push_back(s);
-    ofstream file(get_sessions_file(), ios::app);
-    file << s.timestamp << " " << s.deck << " " << s.correct << " " 
-         << s.total << " " << s.score << " " << s.mode << "\n";
-}
+// ==========================================
+// Deck Snapshot
+// ==========================================
+// Serialized /api/decks payload, rebuilt once per mutation and shared
+// read-only between all requests.
+struct DecksSnapshot {
+    string json;
+    string etag;
+};
 
 // ==========================================
-// Main
+// Review Scheduling
 // ==========================================
-int main(int argc, char* argv[]) {
-    int port = 8080;
-    bool should_open_browser = true;
+// SM-2 style review state for one word. Intervals are whole days and ease
+// is stored in thousandths. due == 0 marks a card that was never reviewed.
+struct CardState {
+    long long due = 0;
+    uint32_t interval = 0;
+    uint16_t ease = 2500;
+    uint16_t reps = 0;
+    uint16_t lapses = 0;
+};
 
-    for (int i = 1; i < argc; ++i) {
-        string arg = argv[i];
-        if (arg == "--port" && i + 1 < argc) {
-            port = stoi(argv[++i]);
-        } else if (arg == "--no-browser") {
-            should_open_browser = false;
-        }
-    }
+// Index of the lowest set bit of a non-zero word
+inline unsigned lowest_bit(uint64_t x) {
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward64(&i, x);
+    return (unsigned)i;
+#else
+    return (unsigned)__builtin_ctzll(x);
+#endif
+}
 
-    cout << "Vocalo - Language Learning App\n";
-    cout << "Data: " << get_data_directory() << "\n";
+// Review state for one deck, indexed by word position in Deck::words.
+// Reviewed cards sit in an indexed binary min-heap on (due, id), so the
+// next N due cards cost O(N log N) to find however large the deck is.
+// New cards are handed out in deck order from a two-level bitmap, which
+// skips runs of reviewed cards 64 and 4096 at a time.
+struct DeckSchedule {
+    static constexpr uint32_t npos = UINT32_MAX;
+    vector<CardState> cards;
+    vector<uint32_t> heap;  // word ids in heap order
+    vector<uint32_t> pos;   // word id -> heap slot, npos while new
+    vector<uint64_t> new_bits;   // bit id % 64 of word id / 64: card id is new
+    vector<uint64_t> new_words;  // bit w % 64 of word w / 64: new_bits[w] != 0
 
-    load_decks();
-    load_sessions();
+    void clear_new(uint32_t id) {
+        size_t w = id / 64;
+        new_bits[w] &= ~(1ULL << (id % 64));
+        if (!new_bits[w]) new_words[w / 64] &= ~(1ULL << (w % 64));
+    }
 
-    httplib::Server svr;
+    bool before(uint32_t a, uint32_t b) const {
+        return cards[a].due != cards[b].due ? cards[a].due < cards[b].due : a < b;
+    }
 
-    svr.Get("/", [](const httplib::Request&, httplib::Response& res) {
-        res.set_content(read_file_content("index.html"), "text/html");
-    });
+    void place(size_t slot, uint32_t id) {
+        heap[slot] = id;
+        pos[id] = (uint32_t)slot;
+    }
 
-    svr.Get("/api/decks", [](const httplib::Request&, httplib::Response& res) {
-        string json = "{";
-        bool first = true;
-        for (const auto& [id, deck] : decks) {
-            if (!first) json += ",";
-            first = false;
-            json += "\"" + id + "\":{";
-            json += "\"name\":\"" + escape_json(deck.name) + "\",";
-            json += "\"description\":\"" + escape_json(deck.description) + "\",";
-            json += "\"words\":[";
-            for (size_t i = 0; i < deck.words.size(); i++) {
-                const auto& w = deck.words[i];
-                json += "{\"word\":\"" + escape_json(w.word) + "\",";
-                json += "\"translation\":\"" + escape_json(w.translation) + "\",";
-                json += "\"definition\":\"" + escape_json(w.definition) + "\",";
-                json += "\"example\":\"" + escape_json(w.example) + "\",";
-                json += "\"hint\":\"" + escape_json(w.hint) + "\"}";
-                if (i < deck.words.size() - 1) json += ",";
-            }
-            json += "]}";
+    void sift_up(size_t slot) {
+        uint32_t id = heap[slot];
+        while (slot > 0) {
+            size_t parent = (slot - 1) / 2;
+            if (!before(id, heap[parent])) break;
+            place(slot, heap[parent]);
+            slot = parent;
         }
-        json += "}";
-        res.set_content(json, "application/json");
-    });
-
-    svr.Post("/api/save-deck", [](const httplib::Request& req, httplib::Response& res) {
-        // Parse JSON body
-        string b = req.body;
-        auto getStr = [&](const string& key) -> string {
-            size_t pos = b.find("\"" + key + "\"");
-            if (pos == string::npos) return "";
-            size_t start = b.find("\"", pos + key.length() + 2) + 1;
-            size_t end = start;
-            while (end < b.size() && !(b[end] == '"' && b[end-1] != '\\')) end++;
-            return b.substr(start, end - start);
-        };
-
-        string id = getStr("id");
-        Deck deck;
-        deck.name = getStr("name");
-        deck.description = getStr("description");
-
-        // Parse words array
-        size_t wordsStart = b.find("\"words\"");
-        if (wordsStart != string::npos) {
-            size_t arrStart = b.find("[", wordsStart);
-            size_t arrEnd = b.rfind("]");
-            string arr = b.substr(arrStart, arrEnd - arrStart + 1);
-
-            size_t pos = 0;
-            while ((pos = arr.find("{", pos)) != string::npos) {
-                size_t end = arr.find("}", pos);
-                string obj = arr.substr(pos, end - pos + 1);
-
-                auto getField = [&](const string& f) -> string {
-                    size_t fp = obj.find("\"" + f + "\"");
-                    if (fp == string::npos) return "";
-                    size_t vs = obj.find("\"", fp + f.length() + 2) + 1;
-                    size_t ve = vs;
-                    while (ve < obj.size() && !(obj[ve] == '"' && obj[ve-1] != '\\')) ve++;
-                    return obj.substr(vs, ve - vs);
-                };
+        place(slot, id);
+    }
 
-                Word w;
-                w.word = getField("word");
-                w.translation = getField("translation");
-                w.definition = getField("definition");
-                w.example = getField("example");
-                w.hint = getField("hint");
-                if (!w.word.empty()) deck.words.push_back(w);
+    void sift_down(size_t slot) {
+        uint32_t id = heap[slot];
+        while (true) {
+            size_t child = 2 * slot + 1;
+            if (child >= heap.size()) break;
+            if (child + 1 < heap.size() && before(heap[child + 1], heap[child])) child++;
+            if (!before(heap[child], id)) break;
+            place(slot, heap[child]);
+            slot = child;
+        }
+        place(slot, id);
+    }
 
-                pos = end + 1;
+    // Takes ownership of a fully populated cards vector and builds the heap
+    void assign(vector<CardState> states) {
+        cards = std::move(states);
+        heap.clear();
+        pos.assign(cards.size(), npos);
+        new_bits.assign((cards.size() + 63) / 64, 0);
+        new_words.assign((new_bits.size() + 63) / 64, 0);
+        for (uint32_t id = 0; id < cards.size(); id++) {
+            if (cards[id].due) {
+                pos[id] = (uint32_t)heap.size();
+                heap.push_back(id);
+            } else {
+                new_bits[id / 64] |= 1ULL << (id % 64);
+                new_words[id / 4096] |= 1ULL << (id / 64 % 64);
             }
         }
+        for (size_t slot = heap.size() / 2; slot-- > 0;) sift_down(slot);
+    }
 
-        if (!id.empty() && !deck.name.empty()) {
-            decks[id] = deck;
-            save_decks();
+    // Re-establishes heap order after cards[id].due was set
+    void updated(uint32_t id) {
+        if (pos[id] == npos) {
+            pos[id] = (uint32_t)heap.size();
+            heap.push_back(id);
+            sift_up(heap.size() - 1);
+            clear_new(id);
+        } else {
+            sift_up(pos[id]);
+            sift_down(pos[id]);
         }
+    }
 
-        res.set_content("{\"ok\":true}", "application/json");
-    });
+    // Appends up to n reviewed cards due at or before now, earliest first,
+    // by walking the heap best-first without disturbing it
+    void due_cards(size_t n, long long now, vector<uint32_t>& out) const {
+        if (heap.empty() || n == 0) return;
+        auto later = [this](uint32_t a, uint32_t b) { return before(heap[b], heap[a]); };
+        vector<uint32_t> frontier{0};
+        while (!frontier.empty() && n > 0) {
+            pop_heap(frontier.begin(), frontier.end(), later);
+            uint32_t slot = frontier.back();
+            frontier.pop_back();
+            if (cards[heap[slot]].due > now) break;
+            out.push_back(heap[slot]);
+            n--;
+            for (size_t child = 2 * (size_t)slot + 1; child <= 2 * (size_t)slot + 2 && child < heap.size(); child++) {
+                frontier.push_back((uint32_t)child);
+                push_heap(frontier.begin(), frontier.end(), later);
+            }
+        }
+    }
 
-    svr.Delete("/api/delete-deck", [](const httplib::Request& req, httplib::Response& res) {
-        string b = req.body;
-        size_t pos = b.find("\"id\"");
-        if (pos != string::npos) {
-            size_t start = b.find("\"", pos + 4) + 1;
-            size_t end = b.find("\"", start);
-            string id = b.substr(start, end - start);
-            decks.erase(id);
-            save_decks();
+    // Appends up to n never-reviewed cards in deck order
+    void new_cards(size_t n, vector<uint32_t>& out) const {
+        for (size_t s = 0; s < new_words.size() && n > 0; s++) {
+            for (uint64_t words = new_words[s]; words && n > 0; words &= words - 1) {
+                size_t w = s * 64 + lowest_bit(words);
+                for (uint64_t bits = new_bits[w]; bits && n > 0; bits &= bits - 1, n--) {
+                    out.push_back((uint32_t)(w * 64 + lowest_bit(bits)));
+                }
+            }
         }
-        res.set_content("{\"ok\":true}", "application/json");
-    });
+    }
+};
 
-    svr.Post("/api/save-session", [](const httplib::Request& req, httplib::Response& res) {
-        string b = req.body;
-        auto getInt = [&](const string& key) -> int {
-            size_t pos = b.find("\"" + key + "\"");
-            if (pos == string::npos) return 0;
-            size_t start = b.find(":", pos) + 1;
-            while (start < b.size() && !isdigit(b[start]) && b[start] != '-') start++;
-            return stoi(b.substr(start));
+// Ratings match the review buttons: 0 again, 1 hard, 2 good, 3 easy
+void apply_review(CardState& c, int rating, long long now) {
+    const long long day_ms = 86400000;
+    if (rating <= 0) {
+        c.lapses++;
+        c.reps = 0;
+        c.interval = 0;
+        c.ease = (uint16_t)max(1300, c.ease - 200);
+        c.due = now + 60000;
+        return;
+    }
+    double next;
+    if (rating == 1) {
+        c.ease = (uint16_t)max(1300, c.ease - 150);
+        next = max(1.0, c.interval * 1.2);
+    } else if (c.reps == 0) {
+        next = rating == 2 ? 1 : 4;
+    } else if (c.reps == 1 && rating == 2) {
+        next = 3;
+    } else {
+        if (rating == 3) c.ease = (uint16_t)min(5000, c.ease + 150);
+        next = max(c.interval + 1.0, c.interval * c.ease / 1000.0 * (rating == 3 ? 1.3 : 1.0));
+    }
+    c.interval = (uint32_t)min(next, 36500.0);
+    if (c.reps < UINT16_MAX) c.reps++;
+    c.due = now + c.interval * day_ms;
+}
+
+// ==========================================
+// Answer Checking
+// ==========================================
+// Typed answers are compared on normalized text: lowercased, with
+// surrounding punctuation and extra whitespace dropped, and optionally
+// with accents folded away (both precomposed letters and combining
+// marks), so "¿Cómo?" and "como" compare equal once folded. Each output
+// character remembers the UTF-16 range it came from, so a diff can be
+// reported in offsets the UI can slice with.
+struct FoldedText {
+    u32string text;
+    vector<uint32_t> from;  // UTF-16 offset where text[i] starts in the input
+    vector<uint32_t> to;    // ... and where it ends
+};
+
+// Base letter for each lowercase code point in U+00C0..U+017F
+const uint16_t latin_base[192] = {
+    0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0xE6, 0x63,  // U+00C0
+    0x65, 0x65, 0x65, 0x65, 0x69, 0x69, 0x69, 0x69,  // U+00C8
+    0xF0, 0x6E, 0x6F, 0x6F, 0x6F, 0x6F, 0x6F, 0xD7,  // U+00D0
+    0x6F, 0x75, 0x75, 0x75, 0x75, 0x79, 0xFE, 0xDF,  // U+00D8
+    0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0xE6, 0x63,  // U+00E0
+    0x65, 0x65, 0x65, 0x65, 0x69, 0x69, 0x69, 0x69,  // U+00E8
+    0xF0, 0x6E, 0x6F, 0x6F, 0x6F, 0x6F, 0x6F, 0xF7,  // U+00F0
+    0x6F, 0x75, 0x75, 0x75, 0x75, 0x79, 0xFE, 0x79,  // U+00F8
+    0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x63, 0x63,  // U+0100
+    0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x64, 0x64,  // U+0108
+    0x64, 0x64, 0x65, 0x65, 0x65, 0x65, 0x65, 0x65,  // U+0110
+    0x65, 0x65, 0x65, 0x65, 0x67, 0x67, 0x67, 0x67,  // U+0118
+    0x67, 0x67, 0x67, 0x67, 0x68, 0x68, 0x68, 0x68,  // U+0120
+    0x69, 0x69, 0x69, 0x69, 0x69, 0x69, 0x69, 0x69,  // U+0128
+    0x69, 0x69, 0x133, 0x133, 0x6A, 0x6A, 0x6B, 0x6B,  // U+0130
+    0x6B, 0x6C, 0x6C, 0x6C, 0x6C, 0x6C, 0x6C, 0x6C,  // U+0138
+    0x6C, 0x6C, 0x6C, 0x6E, 0x6E, 0x6E, 0x6E, 0x6E,  // U+0140
+    0x6E, 0x6E, 0x14B, 0x14B, 0x6F, 0x6F, 0x6F, 0x6F,  // U+0148
+    0x6F, 0x6F, 0x153, 0x153, 0x72, 0x72, 0x72, 0x72,  // U+0150
+    0x72, 0x72, 0x73, 0x73, 0x73, 0x73, 0x73, 0x73,  // U+0158
+    0x73, 0x73, 0x74, 0x74, 0x74, 0x74, 0x74, 0x74,  // U+0160
+    0x75, 0x75, 0x75, 0x75, 0x75, 0x75, 0x75, 0x75,  // U+0168
+    0x75, 0x75, 0x75, 0x75, 0x77, 0x77, 0x79, 0x79,  // U+0170
+    0x79, 0x7A, 0x7A, 0x7A, 0x7A, 0x7A, 0x7A, 0x73,  // U+0178
+};
+
+// Simple lowercase mapping for Latin, Greek and Cyrillic
+char32_t fold_case(char32_t c) {
+    if (c < 0x80) return (c >= 'A' && c <= 'Z') ? c + 32 : c;
+    if (c >= 0xC0 && c <= 0xDE && c != 0xD7) return c + 32;
+    if (c == 0x130) return 'i';
+    if (c == 0x178) return 0xFF;
+    if ((c >= 0x100 && c <= 0x137) || (c >= 0x14A && c <= 0x177)) return c | 1;
+    if ((c >= 0x139 && c <= 0x148) || (c >= 0x179 && c <= 0x17E)) return (c & 1) ? c + 1 : c;
+    if (c >= 0x391 && c <= 0x3AB && c != 0x3A2) return c + 32;
+    if (c >= 0x410 && c <= 0x42F) return c + 32;
+    if (c >= 0x400 && c <= 0x40F) return c + 80;
+    return c;
+}
+
+bool is_answer_punct(char32_t c) {
+    return c == '.' || c == ',' || c == '!' || c == '?' || c == ';' || c == ':' ||
+           c == '"' || c == 0xA1 || c == 0xBF;  // ¡ ¿
+}
+
+// Decodes the UTF-8 sequence at s[i] and advances i past it. Malformed
+// bytes decode as U+FFFD, one at a time.
+char32_t next_code_point(string_view s, size_t& i) {
+    unsigned char b = (unsigned char)s[i];
+    size_t len = b < 0x80 ? 1 : (b >> 5) == 6 ? 2 : (b >> 4) == 14 ? 3 : (b >> 3) == 30 ? 4 : 0;
+    if (len == 0 || i + len > s.size()) {
+        i++;
+        return 0xFFFD;
+    }
+    char32_t c = len == 1 ? b : b & (0x7F >> len);
+    for (size_t k = 1; k < len; k++) {
+        unsigned char cont = (unsigned char)s[i + k];
+        if ((cont & 0xC0) != 0x80) {
+            i += k;
+            return 0xFFFD;
+        }
+        c = (c << 6) | (cont & 0x3F);
+    }
+    i += len;
+    return c;
+}
+
+void append_utf8(string& out, char32_t c) {
+    if (c < 0x80) {
+        out += (char)c;
+    } else if (c < 0x800) {
+        out += (char)(0xC0 | (c >> 6));
+        out += (char)(0x80 | (c & 0x3F));
+    } else if (c < 0x10000) {
+        out += (char)(0xE0 | (c >> 12));
+        out += (char)(0x80 | ((c >> 6) & 0x3F));
+        out += (char)(0x80 | (c & 0x3F));
+    } else {
+        out += (char)(0xF0 | (c >> 18));
+        out += (char)(0x80 | ((c >> 12) & 0x3F));
+        out += (char)(0x80 | ((c >> 6) & 0x3F));
+        out += (char)(0x80 | (c & 0x3F));
+    }
+}
+
+FoldedText fold_answer(string_view s, bool strip_accents) {
+    FoldedText out;
+    out.text.reserve(s.size());
+    uint32_t u16 = 0;
+    bool pending_space = false;
+    auto emit = [&](char32_t c, uint32_t from, uint32_t to) {
+        if (pending_space && !out.text.empty()) {
+            out.text.push_back(' ');
+            out.from.push_back(from);
+            out.to.push_back(from);
+        }
+        pending_space = false;
+        out.text.push_back(c);
+        out.from.push_back(from);
+        out.to.push_back(to);
+    };
+    for (size_t i = 0; i < s.size();) {
+        char32_t c = next_code_point(s, i);
+        uint32_t from = u16;
+        u16 += c >= 0x10000 ? 2 : 1;
+
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == 0xA0) {
+            pending_space = true;
+            continue;
+        }
+        if (is_answer_punct(c)) continue;
+        c = fold_case(c);
+        if (strip_accents) {
+            if (c >= 0x300 && c <= 0x36F) continue;  // combining marks
+            if (c >= 0xC0 && c <= 0x17F) c = latin_base[c - 0xC0];
+            const char* pair = c == 0xDF ? "ss" : c == 0xE6 ? "ae" : c == 0x153 ? "oe" : c == 0x133 ? "ij" : nullptr;
+            if (pair) {
+                emit(pair[0], from, u16);
+                emit(pair[1], from, u16);
+                continue;
+            }
+        } else if (c >= 0x300 && c <= 0x36F && !out.text.empty()) {
+            // Keep a combining mark attached to its base in the span map
+            out.text.push_back(c);
+            out.from.push_back(out.from.back());
+            out.to.push_back(u16);
+            out.to[out.to.size() - 2] = u16;
+            continue;
+        }
+        emit(c, from, u16);
+    }
+    return out;
+}
+
+// Edit distance between a and b counting insertions, deletions,
+// substitutions and transpositions of adjacent characters (optimal string
+// alignment), or max_dist + 1 once it is known to exceed max_dist. When
+// the shorter string fits in 64 characters this is Hyyrö's bit-parallel
+// form of Myers' algorithm: a column of the DP matrix is a pair of bit
+// vectors, advanced with a handful of word operations per character of
+// the longer string. Longer inputs fall back to the DP restricted to the
+// band |i - j| <= max_dist.
+size_t bounded_edit_distance(u32string_view a, u32string_view b, size_t max_dist) {
+    if (a.size() > b.size()) swap(a, b);
+    const size_t m = a.size(), n = b.size();
+    if (n - m > max_dist) return max_dist + 1;
+    if (m == 0) return n;
+
+    if (m <= 64) {
+        // Match masks; only the ASCII slots that will be read are cleared
+        uint64_t ascii[128];
+        vector<pair<char32_t, uint64_t>> other;
+        for (char32_t c : a) if (c < 128) ascii[c] = 0;
+        for (char32_t c : b) if (c < 128) ascii[c] = 0;
+        for (size_t i = 0; i < m; i++) {
+            char32_t c = a[i];
+            if (c < 128) {
+                ascii[c] |= 1ull << i;
+                continue;
+            }
+            auto it = find_if(other.begin(), other.end(), [c](const auto& e) { return e.first == c; });
+            if (it == other.end()) other.push_back({c, 1ull << i});
+            else it->second |= 1ull << i;
+        }
+        auto peq = [&](char32_t c) -> uint64_t {
+            if (c < 128) return ascii[c];
+            for (const auto& e : other) if (e.first == c) return e.second;
+            return 0;
+        };
+
+        const uint64_t high = 1ull << (m - 1);
+        uint64_t pv = ~0ull, mv = 0, d0 = 0, prev_eq = 0;
+        size_t score = m;
+        for (size_t j = 0; j < n; j++) {
+            uint64_t eq = peq(b[j]);
+            uint64_t tr = (((~d0) & eq) << 1) & prev_eq;
+            d0 = (((eq & pv) + pv) ^ pv) | eq | mv | tr;
+            uint64_t ph = mv | ~(d0 | pv);
+            uint64_t mh = pv & d0;
+            if (ph & high) score++;
+            else if (mh & high) score--;
+            // The score can fall by at most one per remaining character
+            if (score > max_dist + (n - j - 1)) return max_dist + 1;
+            ph = (ph << 1) | 1;
+            mh <<= 1;
+            pv = mh | ~(d0 | ph);
+            mv = ph & d0;
+            prev_eq = eq;
+        }
+        return score <= max_dist ? score : max_dist + 1;
+    }
+
+    const size_t inf = max_dist + 1;
+    vector<size_t> before(m + 1, inf), prev(m + 1, inf), cur(m + 1, inf);
+    for (size_t i = 0; i <= min(m, max_dist); i++) prev[i] = i;
+    for (size_t j = 1; j <= n; j++) {
+        size_t lo = j > max_dist ? j - max_dist : 1;
+        size_t hi = min(m, j + max_dist);
+        fill(cur.begin(), cur.end(), inf);
+        if (j <= max_dist) cur[0] = j;
+        size_t best = cur[0];
+        for (size_t i = lo; i <= hi; i++) {
+            size_t d = prev[i - 1] + (a[i - 1] == b[j - 1] ? 0 : 1);
+            d = min({d, prev[i] + 1, cur[i - 1] + 1});
+            if (i > 1 && j > 1 && a[i - 1] == b[j - 2] && a[i - 2] == b[j - 1]) d = min(d, before[i - 2] + 1);
+            cur[i] = min(d, inf);
+            best = min(best, cur[i]);
+        }
+        if (best > max_dist) return inf;
+        swap(before, prev);
+        swap(prev, cur);
+    }
+    return min(prev[m], inf);
+}
+
+struct AnswerCheck {
+    const char* result;  // "exact", "near" or "wrong"
+    size_t distance;     // accent-insensitive; max + 1 when wrong
+    uint32_t span[2];    // differing UTF-16 range in the answer
+    uint32_t expected_span[2];
+};
+
+// How many edits still count as a near miss: none for very short words,
+// where one letter usually makes a different word
+size_t answer_tolerance(size_t expected_len) {
+    return expected_len <= 3 ? 0 : expected_len <= 7 ? 1 : 2;
+}
+
+AnswerCheck check_answer(string_view answer, string_view expected, long long max_distance) {
+    AnswerCheck r{};
+    FoldedText given = fold_answer(answer, false);
+    FoldedText want = fold_answer(expected, false);
+
+    // Differing span: whatever is left after the common prefix and suffix
+    size_t prefix = 0;
+    while (prefix < given.text.size() && prefix < want.text.size() && given.text[prefix] == want.text[prefix]) prefix++;
+    size_t suffix = 0;
+    while (suffix < given.text.size() - prefix && suffix < want.text.size() - prefix &&
+           given.text[given.text.size() - 1 - suffix] == want.text[want.text.size() - 1 - suffix]) suffix++;
+    auto span = [](const FoldedText& f, size_t begin, size_t end, uint32_t out[2]) {
+        if (begin < end) {
+            out[0] = f.from[begin];
+            out[1] = f.to[end - 1];
+        } else {
+            out[0] = out[1] = begin < f.from.size() ? f.from[begin] : (f.to.empty() ? 0 : f.to.back());
+        }
+    };
+    span(given, prefix, given.text.size() - suffix, r.span);
+    span(want, prefix, want.text.size() - suffix, r.expected_span);
+
+    if (given.text == want.text) {
+        r.result = "exact";
+        return r;
+    }
+    u32string a = fold_answer(answer, true).text;
+    u32string b = fold_answer(expected, true).text;
+    size_t k = max_distance >= 0 ? (size_t)min(max_distance, 8LL) : answer_tolerance(b.size());
+    r.distance = bounded_edit_distance(a, b, k);
+    r.result = r.distance <= k ? "near" : "wrong";
+    return r;
+}
+
+// ==========================================
+// Search Index
+// ==========================================
+// Fuzzy search over word, translation and definition across all decks.
+// Fields are folded the same way answers are (case, accents, punctuation)
+// and cut into trigrams, padded at word boundaries; one posting list per
+// trigram holds the fields containing it. A query only verifies fields
+// sharing enough trigrams to possibly be within the edit bound, and ranks
+// them by edit distance. Words and translations are also kept in an array
+// sorted by folded text, so prefix completion is a binary search.
+//
+// Updates are per deck: the deck's previous entries become tombstones,
+// and everything is rebuilt once more than half of the entries are dead.
+class SearchIndex {
+public:
+    enum Field : uint8_t { WORD, TRANSLATION, DEFINITION };
+
+    struct Hit {
+        const string* deck;
+        uint32_t pos;       // word position within the deck
+        Field field;        // best matching field
+        uint32_t distance;  // edit distance to the query (0 for prefixes)
+        uint32_t rank;      // 0 exact, 1 prefix, 1 + distance for fuzzy matches
+        uint32_t length;    // folded length of the field, shorter ranks first
+    };
+
+private:
+    struct Doc {
+        uint32_t deck;  // slot in deck_ids
+        uint32_t pos;
+        bool alive;
+        string text[3];  // folded fields, UTF-8
+    };
+    static constexpr char32_t word_start = 2, word_end = 3;
+
+    vector<Doc> docs;
+    vector<string> deck_ids;
+    unordered_map<string, uint32_t> deck_slots;
+    vector<vector<uint32_t>> deck_docs;
+    // Entries are refs: doc << 2 | field
+    unordered_map<uint64_t, vector<uint32_t>> postings;
+    vector<uint32_t> by_text;
+    size_t dead = 0;
+    bool ready = false;
+
+    static uint32_t ref(uint32_t doc, Field f) { return doc << 2 | f; }
+    const string& text(uint32_t r) const { return docs[r >> 2].text[r & 3]; }
+
+    static string fold(string_view s) {
+        string out;
+        for (char32_t c : fold_answer(s, true).text) append_utf8(out, c);
+        return out;
+    }
+
+    static u32string decode(string_view s) {
+        u32string out;
+        for (size_t i = 0; i < s.size();) out.push_back(next_code_point(s, i));
+        return out;
+    }
+
+    // Distinct padded trigrams of every space-separated token in s
+    static void trigrams(u32string_view s, vector<uint64_t>& out) {
+        size_t start = 0;
+        while (start <= s.size()) {
+            size_t end = s.find(' ', start);
+            if (end == u32string_view::npos) end = s.size();
+            if (end > start) {
+                char32_t prev2 = word_start, prev1 = s[start];
+                for (size_t i = start + 1; i <= end; i++) {
+                    char32_t c = i < end ? s[i] : word_end;
+                    out.push_back((uint64_t)prev2 << 42 | (uint64_t)prev1 << 21 | c);
+                    prev2 = prev1;
+                    prev1 = c;
+                }
+            }
+            start = end + 1;
+        }
+        sort(out.begin(), out.end());
+        out.erase(unique(out.begin(), out.end()), out.end());
+    }
+
+    void add_postings(uint32_t doc, vector<uint64_t>& scratch) {
+        for (int f = WORD; f <= DEFINITION; f++) {
+            scratch.clear();
+            trigrams(decode(docs[doc].text[f]), scratch);
+            for (uint64_t g : scratch) postings[g].push_back(ref(doc, (Field)f));
+        }
+    }
+
+    void sort_refs(vector<uint32_t>& refs) const {
+        sort(refs.begin(), refs.end(), [this](uint32_t a, uint32_t b) { return text(a) < text(b); });
+    }
+
+    void remove_slot(uint32_t slot) {
+        for (uint32_t doc : deck_docs[slot]) {
+            docs[doc].alive = false;
+            dead++;
+        }
+        deck_docs[slot].clear();
+    }
+
+    // Drops tombstones and rebuilds postings and the sorted array
+    void compact() {
+        vector<Doc> live;
+        live.reserve(docs.size() - dead);
+        for (auto& list : deck_docs) list.clear();
+        for (auto& d : docs) {
+            if (!d.alive) continue;
+            deck_docs[d.deck].push_back((uint32_t)live.size());
+            live.push_back(std::move(d));
+        }
+        docs = std::move(live);
+        dead = 0;
+        postings.clear();
+        by_text.clear();
+        vector<uint64_t> scratch;
+        for (uint32_t doc = 0; doc < docs.size(); doc++) {
+            add_postings(doc, scratch);
+            for (Field f : {WORD, TRANSLATION}) {
+                if (!docs[doc].text[f].empty()) by_text.push_back(ref(doc, f));
+            }
+        }
+        sort_refs(by_text);
+    }
+
+    static vector<Hit> ranked(const unordered_map<uint32_t, Hit>& best, size_t limit) {
+        vector<Hit> hits;
+        hits.reserve(best.size());
+        for (const auto& [doc, h] : best) hits.push_back(h);
+        auto order = [](const Hit& a, const Hit& b) {
+            if (a.rank != b.rank) return a.rank < b.rank;
+            if (a.length != b.length) return a.length < b.length;
+            if (a.field != b.field) return a.field < b.field;
+            if (*a.deck != *b.deck) return *a.deck < *b.deck;
+            return a.pos < b.pos;
+        };
+        if (hits.size() > limit) {
+            partial_sort(hits.begin(), hits.begin() + limit, hits.end(), order);
+            hits.resize(limit);
+        } else {
+            sort(hits.begin(), hits.end(), order);
+        }
+        return hits;
+    }
+
+public:
+    bool built() const { return ready; }
+
+    void build(const map<string, Deck>& decks) {
+        docs.clear();
+        deck_ids.clear();
+        deck_slots.clear();
+        deck_docs.clear();
+        dead = 0;
+        for (const auto& [id, deck] : decks) {
+            uint32_t slot = (uint32_t)deck_ids.size();
+            deck_ids.push_back(id);
+            deck_slots[id] = slot;
+            deck_docs.emplace_back();
+            for (uint32_t pos = 0; pos < deck.words.size(); pos++) {
+                const Word& w = deck.words[pos];
+                docs.push_back({slot, pos, true, {fold(w.word), fold(w.translation), fold(w.definition)}});
+            }
+        }
+        compact();
+        ready = true;
+    }
+
+    void put_deck(const string& id, const Deck& deck) {
+        auto [it, inserted] = deck_slots.emplace(id, (uint32_t)deck_ids.size());
+        uint32_t slot = it->second;
+        if (inserted) {
+            deck_ids.push_back(id);
+            deck_docs.emplace_back();
+        } else {
+            remove_slot(slot);
+        }
+        if (dead > docs.size() / 2) compact();
+
+        vector<uint64_t> scratch;
+        vector<uint32_t> added;
+        for (uint32_t pos = 0; pos < deck.words.size(); pos++) {
+            const Word& w = deck.words[pos];
+            uint32_t doc = (uint32_t)docs.size();
+            docs.push_back({slot, pos, true, {fold(w.word), fold(w.translation), fold(w.definition)}});
+            deck_docs[slot].push_back(doc);
+            add_postings(doc, scratch);
+            for (Field f : {WORD, TRANSLATION}) {
+                if (!docs[doc].text[f].empty()) added.push_back(ref(doc, f));
+            }
+        }
+        by_text.erase(remove_if(by_text.begin(), by_text.end(), [this](uint32_t r) { return !docs[r >> 2].alive; }),
+                      by_text.end());
+        sort_refs(added);
+        size_t middle = by_text.size();
+        by_text.insert(by_text.end(), added.begin(), added.end());
+        inplace_merge(by_text.begin(), by_text.begin() + middle, by_text.end(),
+                      [this](uint32_t a, uint32_t b) { return text(a) < text(b); });
+    }
+
+    void remove_deck(const string& id) {
+        auto it = deck_slots.find(id);
+        if (it == deck_slots.end()) return;
+        remove_slot(it->second);
+        by_text.erase(remove_if(by_text.begin(), by_text.end(), [this](uint32_t r) { return !docs[r >> 2].alive; }),
+                      by_text.end());
+        if (dead > docs.size() / 2) compact();
+    }
+
+    // Best match per word, best first
+    vector<Hit> search(string_view query, size_t limit) const {
+        u32string q = fold_answer(query, true).text;
+        if (q.empty() || limit == 0) return {};
+        string qs;
+        for (char32_t c : q) append_utf8(qs, c);
+        const size_t k = answer_tolerance(q.size());
+
+        unordered_map<uint32_t, Hit> best;  // by doc
+        auto offer = [&](uint32_t r, uint32_t distance, uint32_t rank) {
+            Hit h{&deck_ids[docs[r >> 2].deck], docs[r >> 2].pos, (Field)(r & 3), distance, rank, (uint32_t)text(r).size()};
+            auto [it, inserted] = best.emplace(r >> 2, h);
+            if (!inserted && (rank < it->second.rank || (rank == it->second.rank && h.field < it->second.field))) it->second = h;
+        };
+
+        // Prefix completions
+        auto lo = lower_bound(by_text.begin(), by_text.end(), qs,
+                              [this](uint32_t r, const string& v) { return text(r) < v; });
+        size_t taken = 0;
+        for (auto it = lo; it != by_text.end() && taken < limit; ++it, ++taken) {
+            const string& t = text(*it);
+            if (t.compare(0, qs.size(), qs) != 0) break;
+            offer(*it, 0, t.size() == qs.size() ? 0 : 1);
+        }
+
+        // Typeahead: a full page of completions needs no fuzzy fallback
+        if (taken == limit) return ranked(best, limit);
+
+        // Fuzzy matches: an edit breaks at most three padded trigrams and a
+        // transposition four, so a match shares at least need of the query's
+        // grams. Posting lists are in ascending ref order. Every match is in
+        // one of the grams - need + 1 shortest lists; the rest are probed.
+        vector<uint64_t> grams;
+        trigrams(q, grams);
+        const size_t need = grams.size() > 4 * k ? grams.size() - 4 * k : 1;
+        vector<const vector<uint32_t>*> lists;
+        for (uint64_t g : grams) {
+            auto it = postings.find(g);
+            if (it != postings.end()) lists.push_back(&it->second);
+        }
+        if (lists.size() < need) return ranked(best, limit);
+        sort(lists.begin(), lists.end(), [](auto* a, auto* b) { return a->size() < b->size(); });
+        const size_t scanned = lists.size() - need + 1;
+        vector<uint32_t> pool;
+        for (size_t i = 0; i < scanned; i++) pool.insert(pool.end(), lists[i]->begin(), lists[i]->end());
+        sort(pool.begin(), pool.end());
+        vector<pair<uint32_t, uint32_t>> shared;  // ref, grams in common
+        for (size_t i = 0; i < pool.size();) {
+            size_t j = i;
+            while (j < pool.size() && pool[j] == pool[i]) j++;
+            uint32_t r = pool[i], count = (uint32_t)(j - i);
+            i = j;
+            if (!docs[r >> 2].alive) continue;
+            // Whole fields cannot be within k edits at a very different length
+            if ((r & 3) != DEFINITION && text(r).size() + k < q.size()) continue;
+            for (size_t l = scanned; l < lists.size() && count < need && count + (lists.size() - l) >= need; l++) {
+                if (binary_search(lists[l]->begin(), lists[l]->end(), r)) count++;
+            }
+            if (count >= need) shared.emplace_back(r, count);
+        }
+        u32string buf;
+        auto distance_to = [&](string_view t) -> size_t {
+            if (t.size() + k < q.size()) return k + 1;  // never more code points than bytes
+            buf.clear();
+            for (size_t i = 0; i < t.size() && buf.size() <= q.size() + k;) buf.push_back(next_code_point(t, i));
+            return buf.size() > q.size() + k ? k + 1 : bounded_edit_distance(buf, q, k);
+        };
+        for (const auto& [r, count] : shared) {
+            string_view field = text(r);
+            size_t d = k + 1;
+            if ((r & 3) == DEFINITION) {
+                // Compare against each word of the definition
+                size_t start = 0;
+                while (start <= field.size() && d > 0) {
+                    size_t end = field.find(' ', start);
+                    if (end == string_view::npos) end = field.size();
+                    d = min(d, distance_to(field.substr(start, end - start)));
+                    start = end + 1;
+                }
+            } else {
+                d = distance_to(field);
+            }
+            if (d <= k) offer(r, (uint32_t)d, (uint32_t)(d == 0 && field.size() == qs.size() ? 0 : 1 + d));
+        }
+
+        return ranked(best, limit);
+    }
+
+    size_t memory() const {
+        size_t bytes = docs.size() * sizeof(Doc) + by_text.size() * 4 + postings.size() * 48;
+        for (const auto& d : docs) bytes += d.text[0].capacity() + d.text[1].capacity() + d.text[2].capacity();
+        for (const auto& [g, list] : postings) bytes += list.capacity() * 4;
+        return bytes;
+    }
+};
+
+// ==========================================
+// Duplicate Detection
+// ==========================================
+// Words are keyed by their folded word and translation, so "Perro"/"dog"
+// and "perro"/"Dog" are the same card. Exact duplicates within a saved
+// deck are dropped with a hash table over the keys. Across decks, each key
+// gets a MinHash signature over its padded trigrams, cut into bands for
+// locality-sensitive hashing: keys sharing a band bucket are candidates,
+// confirmed with the edit distance used to grade answers. The key hash is
+// one more bucket, so exact copies in other decks are always found.
+//
+// Like the search index, updates are per deck and tombstoned, with a
+// rebuild once more than half of the entries are dead.
+
+// Folded "word\ttranslation"; empty when there is no word
+u32string duplicate_key(const Word& w) {
+    u32string key = fold_answer(w.word, true).text;
+    if (key.empty()) return key;
+    key.push_back('\t');
+    key += fold_answer(w.translation, true).text;
+    return key;
+}
+
+// Drops later exact copies of a word within the deck. Returns the dropped
+// positions, each paired with the position of the copy that was kept, both
+// as submitted.
+vector<pair<uint32_t, uint32_t>> drop_duplicate_words(Deck& deck) {
+    vector<pair<uint32_t, uint32_t>> dropped;
+    unordered_map<u32string, uint32_t> first;
+    first.reserve(deck.words.size());
+    size_t kept = 0;
+    for (uint32_t i = 0; i < deck.words.size(); i++) {
+        u32string key = duplicate_key(deck.words[i]);
+        if (!key.empty()) {
+            auto [it, inserted] = first.emplace(std::move(key), (uint32_t)i);
+            if (!inserted) {
+                dropped.emplace_back(i, it->second);
+                continue;
+            }
+        }
+        if (kept != i) deck.words[kept] = std::move(deck.words[i]);
+        kept++;
+    }
+    deck.words.resize(kept);
+    return dropped;
+}
+
+class DuplicateIndex {
+public:
+    struct Match {
+        uint32_t pos;        // position in the saved deck
+        const string* deck;  // deck holding the other copy
+        uint32_t other;      // its position there
+        uint32_t distance;   // 0 for exact copies
+    };
+
+private:
+    static constexpr int bands = 5, rows = 3;
+    // Candidates verified per word beyond exact copies; bounds the work
+    // when a common band (say, "to ..." verbs) collects a huge bucket
+    static constexpr size_t max_candidates = 64;
+
+    struct Doc {
+        uint32_t deck;  // slot in deck_ids
+        uint32_t pos;
+        bool alive;
+        string key;  // folded, UTF-8
+        uint64_t buckets[bands + 1];
+    };
+
+    vector<Doc> docs;
+    vector<string> deck_ids;
+    unordered_map<string, uint32_t> deck_slots;
+    vector<vector<uint32_t>> deck_docs;
+    unordered_map<uint64_t, vector<uint32_t>> buckets;  // docs per bucket
+    size_t dead = 0;
+    bool ready = false;
+
+    static uint64_t mix(uint64_t x) {
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ULL;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    // Bucket keys: the exact key hash, then one per band of the signature
+    static void bucket_keys(u32string_view key, uint64_t out[bands + 1]) {
+        uint64_t signature[bands * rows];
+        fill(begin(signature), end(signature), UINT64_MAX);
+        char32_t prev2 = 2, prev1 = 2;
+        for (size_t i = 0; i <= key.size(); i++) {
+            char32_t c = i < key.size() ? key[i] : 3;
+            uint64_t g = mix((uint64_t)prev2 << 42 | (uint64_t)prev1 << 21 | c);
+            for (int h = 0; h < bands * rows; h++) signature[h] = min(signature[h], mix(g + 0x9e3779b97f4a7c15ULL * (h + 1)));
+            prev2 = prev1;
+            prev1 = c;
+        }
+        out[0] = fnv1a64(string_view((const char*)key.data(), key.size() * sizeof(char32_t)));
+        for (int b = 0; b < bands; b++) {
+            uint64_t h = b + 1;
+            for (int r = 0; r < rows; r++) h = mix(h ^ signature[b * rows + r]);
+            out[b + 1] = h;
+        }
+    }
+
+    void add(uint32_t slot, uint32_t pos, u32string_view key) {
+        uint32_t doc = (uint32_t)docs.size();
+        Doc d{slot, pos, true, {}, {}};
+        for (char32_t c : key) append_utf8(d.key, c);
+        bucket_keys(key, d.buckets);
+        for (uint64_t b : d.buckets) buckets[b].push_back(doc);
+        docs.push_back(std::move(d));
+        deck_docs[slot].push_back(doc);
+    }
+
+    void remove_slot(uint32_t slot) {
+        for (uint32_t doc : deck_docs[slot]) {
+            docs[doc].alive = false;
+            dead++;
+        }
+        deck_docs[slot].clear();
+    }
+
+    void compact() {
+        vector<Doc> live;
+        live.reserve(docs.size() - dead);
+        for (auto& list : deck_docs) list.clear();
+        buckets.clear();
+        for (auto& d : docs) {
+            if (!d.alive) continue;
+            uint32_t doc = (uint32_t)live.size();
+            deck_docs[d.deck].push_back(doc);
+            for (uint64_t b : d.buckets) buckets[b].push_back(doc);
+            live.push_back(std::move(d));
+        }
+        docs = std::move(live);
+        dead = 0;
+    }
+
+    uint32_t slot_for(const string& id) {
+        auto [it, inserted] = deck_slots.emplace(id, (uint32_t)deck_ids.size());
+        if (inserted) {
+            deck_ids.push_back(id);
+            deck_docs.emplace_back();
+        }
+        return it->second;
+    }
+
+public:
+    bool built() const { return ready; }
+
+    void build(const map<string, Deck>& decks) {
+        docs.clear();
+        deck_ids.clear();
+        deck_slots.clear();
+        deck_docs.clear();
+        buckets.clear();
+        dead = 0;
+        for (const auto& [id, deck] : decks) {
+            uint32_t slot = slot_for(id);
+            for (uint32_t pos = 0; pos < deck.words.size(); pos++) {
+                u32string key = duplicate_key(deck.words[pos]);
+                if (!key.empty()) add(slot, pos, key);
+            }
+        }
+        ready = true;
+    }
+
+    // Replaces the deck's entries. Returns, for each word with one, the
+    // closest other copy in any deck, including earlier words of this one.
+    vector<Match> put_deck(const string& id, const Deck& deck) {
+        uint32_t slot = slot_for(id);
+        remove_slot(slot);
+        if (dead > docs.size() / 2) compact();
+
+        vector<Match> matches;
+        vector<uint32_t> seen;
+        u32string other;
+        for (uint32_t pos = 0; pos < deck.words.size(); pos++) {
+            u32string key = duplicate_key(deck.words[pos]);
+            if (key.empty()) continue;
+            const size_t k = answer_tolerance(key.size());
+            uint64_t keys[bands + 1];
+            bucket_keys(key, keys);
+
+            Match best{pos, nullptr, 0, (uint32_t)k + 1};
+            seen.clear();
+            size_t verified = 0;
+            for (int b = 0; b <= bands && best.distance > 0; b++) {
+                auto it = buckets.find(keys[b]);
+                if (it == buckets.end()) continue;
+                for (uint32_t doc : it->second) {
+                    if (b > 0 && verified == max_candidates) break;
+                    const Doc& d = docs[doc];
+                    if (!d.alive || find(seen.begin(), seen.end(), doc) != seen.end()) continue;
+                    seen.push_back(doc);
+                    verified++;
+                    other.clear();
+                    for (size_t i = 0; i < d.key.size();) other.push_back(next_code_point(d.key, i));
+                    size_t distance = bounded_edit_distance(other, key, k);
+                    if (distance < best.distance) best = {pos, &deck_ids[d.deck], d.pos, (uint32_t)distance};
+                }
+            }
+            if (best.deck) matches.push_back(best);
+            add(slot, pos, key);
+        }
+        return matches;
+    }
+
+    void remove_deck(const string& id) {
+        auto it = deck_slots.find(id);
+        if (it == deck_slots.end()) return;
+        remove_slot(it->second);
+        if (dead > docs.size() / 2) compact();
+    }
+
+    size_t memory() const {
+        size_t bytes = docs.size() * sizeof(Doc) + buckets.size() * 56;
+        for (const auto& d : docs) bytes += d.key.capacity();
+        for (const auto& [b, list] : buckets) bytes += list.capacity() * 4;
+        return bytes;
+    }
+};
+
+// ==========================================
+// Tenants
+// ==========================================
+// Everything that belongs to one learner: decks, session history, review
+// state and the logs persisting them, all under the tenant's own data
+// directory. httplib runs handlers on a thread pool. Readers take the
+// shared side of the locks; mutations take the exclusive side. Lock order
+// is decks_mutex, then schedules_mutex. GET /api/decks needs neither since
+// it only loads the atomically published snapshot.
+struct Tenant {
+    string key;
+    fs::path dir;
+    once_flag loaded;
+    atomic<bool> ready{false};
+
+    map<string, Deck> decks;
+    shared_mutex decks_mutex;
+    shared_ptr<const DecksSnapshot> decks_snapshot = make_shared<DecksSnapshot>();
+    uint64_t decks_version = 0;
+    bool decks_loaded_from_binary = false;
+    GroupCommitLog deck_journal;
+    // Built on the first search and then kept in step with decks (decks_mutex)
+    SearchIndex search;
+    // Likewise, built on the first deck save
+    DuplicateIndex duplicates;
+    // Held while the matching index is built, so one request does the work
+    mutex search_build_mutex;
+    mutex duplicates_build_mutex;
+    // Uploads in progress by deck id, for /api/import-progress
+    struct ImportProgress {
+        size_t bytes;
+        size_t total;  // Content-Length, 0 when unknown
+        size_t words;
+    };
+    unordered_map<string, ImportProgress> imports;
+    mutex imports_mutex;
+
+    vector<Session> sessions;
+    shared_mutex sessions_mutex;
+    // Secondary indexes over sessions, guarded by sessions_mutex. sessions
+    // is kept in timestamp order, so time ranges are a binary search; the
+    // posting lists hold ascending positions into sessions.
+    unordered_map<string, vector<uint32_t>> sessions_by_deck;
+    unordered_map<string, vector<uint32_t>> sessions_by_mode;
+    // Maintained incrementally alongside the session indexes
+    SessionStats stats_overall;
+    map<string, SessionStats> stats_by_deck;
+    map<string, SessionStats> stats_by_mode;
+    map<string, SessionStats> stats_by_day;
+    GroupCommitLog session_log;
+
+    // Keyed by deck id. A deck without an entry has only new cards.
+    unordered_map<string, DeckSchedule> schedules;
+    shared_mutex schedules_mutex;
+    GroupCommitLog review_journal;
+
+    // Inputs to the resident size estimate used for eviction
+    atomic<size_t> deck_bytes{0};
+    atomic<size_t> session_count{0};
+    atomic<size_t> card_count{0};
+    atomic<size_t> search_bytes{0};
+    atomic<size_t> duplicate_bytes{0};
+
+    size_t memory() const {
+        return 64 * 1024 + deck_bytes + session_count * (sizeof(Session) + 96) + card_count * (sizeof(CardState) + 8) +
+               search_bytes + duplicate_bytes;
+    }
+};
+
+void index_session(Tenant& t, size_t i) {
+    t.sessions_by_deck[t.sessions[i].deck].push_back((uint32_t)i);
+    t.sessions_by_mode[t.sessions[i].mode].push_back((uint32_t)i);
+}
+
+void aggregate_session(Tenant& t, const Session& s) {
+    t.stats_overall.add(s);
+    t.stats_by_deck[s.deck].add(s);
+    t.stats_by_mode[s.mode].add(s);
+    t.stats_by_day[utc_day(s.timestamp)].add(s);
+}
+
+void rebuild_decks_snapshot(Tenant& t) {
+    size_t estimate = 2;
+    size_t deck_bytes = 0;
+    for (const auto& [id, deck] : t.decks) {
+        estimate += id.size() + deck.name.size() + deck.description.size() + 48;
+        for (const auto& w : deck.words) {
+            estimate += w.word.size() + w.translation.size() + w.definition.size() +
+                        w.example.size() + w.hint.size() + 72;
+        }
+        deck_bytes += id.size() + deck.name.size() + deck.description.size() + sizeof(Deck) + 64 +
+                      deck.words.capacity() * sizeof(Word) + deck.text_bytes;
+    }
+    // Decks mapped from decks.bin cost Word objects only; their text is page
+    // cache the kernel can drop
+    t.deck_bytes = deck_bytes + estimate;
+
+    auto snap = make_shared<DecksSnapshot>();
+    string& json = snap->json;
+    json.reserve(estimate);
+    json += '{';
+    bool first = true;
+    for (const auto& [id, deck] : t.decks) {
+        if (!first) json += ',';
+        first = false;
+        json += '"'; append_json_escaped(json, id); json += "\":";
+        append_deck_json(json, deck);
+    }
+    json += '}';
+
+    char tag[48];
+    snprintf(tag, sizeof(tag), "\"%llu-%016llx\"",
+             (unsigned long long)++t.decks_version, (unsigned long long)fnv1a64(json));
+    snap->etag = tag;
+
+    atomic_store(&t.decks_snapshot, shared_ptr<const DecksSnapshot>(std::move(snap)));
+}
+
+bool same_words(const Deck& a, const Deck& b) {
+    return equal(a.words.begin(), a.words.end(), b.words.begin(), b.words.end(), [](const Word& x, const Word& y) {
+        return x.word == y.word && x.translation == y.translation && x.definition == y.definition &&
+               x.example == y.example && x.hint == y.hint;
+    });
+}
+
+// Builds the search or duplicate index without holding decks_mutex
+// exclusively: the decks are copied under the shared lock and folded with
+// no lock held, so requests go on meanwhile. Decks saved or deleted during
+// the build are then brought up to date under the exclusive lock, which
+// costs a comparison rather than a rebuild. Call without decks_mutex held.
+template <class Index>
+void build_deck_index(Tenant& t, Index& index, atomic<size_t>& bytes, mutex& build_mutex) {
+    {
+        shared_lock lock(t.decks_mutex);
+        if (index.built()) return;
+    }
+    lock_guard building(build_mutex);
+    map<string, Deck> decks;
+    uint64_t version;
+    {
+        shared_lock lock(t.decks_mutex);
+        if (index.built()) return;
+        decks = t.decks;
+        version = t.decks_version;
+    }
+    Index fresh;
+    fresh.build(decks);
+
+    unique_lock lock(t.decks_mutex);
+    if (t.decks_version != version) {
+        for (const auto& [id, deck] : t.decks) {
+            auto old = decks.find(id);
+            if (old == decks.end() || !same_words(old->second, deck)) fresh.put_deck(id, deck);
+        }
+        for (const auto& [id, deck] : decks) {
+            if (!t.decks.count(id)) fresh.remove_deck(id);
+        }
+    }
+    index = std::move(fresh);
+    bytes = index.memory();
+}
+
+// ==========================================
+// Persistence
+// ==========================================
+// Reads the members of a word object, after begin_object()
+void read_word(JsonReader& r, WordFields& w) {
+    string_view key;
+    while (r.next_key(key)) {
+        if (key == "word") r.read_string(w.word);
+        else if (key == "translation") r.read_string(w.translation);
+        else if (key == "definition") r.read_string(w.definition);
+        else if (key == "example") r.read_string(w.example);
+        else if (key == "hint") r.read_string(w.hint);
+        else r.skip_value();
+    }
+}
+
+// Reads a "words" array into the deck, dropping entries without a word
+void read_words(JsonReader& r, Deck& deck) {
+    if (!r.begin_array()) {
+        r.skip_value();
+        return;
+    }
+    vector<WordFields> words;
+    while (r.next_element()) {
+        if (!r.begin_object()) {
+            r.skip_value();
+            continue;
+        }
+        WordFields& w = words.emplace_back();
+        read_word(r, w);
+        if (w.word.empty()) words.pop_back();
+    }
+    pack_words(deck, words);
+}
+
+// Reads one deck member (name/description/words); returns false for unknown keys
+bool read_deck_field(JsonReader& r, string_view key, Deck& deck) {
+    if (key == "name") r.read_string(deck.name);
+    else if (key == "description") r.read_string(deck.description);
+    else if (key == "words") read_words(r, deck);
+    else return false;
+    return true;
+}
+
+fs::path get_decks_file(const Tenant& t) { return t.dir / "decks.json"; }
+fs::path get_sessions_file(const Tenant& t) { return t.dir / "sessions.txt"; }
+fs::path get_deck_journal_file(const Tenant& t) { return t.dir / "decks.journal"; }
+
+// Deck mutations are appended to decks.journal as one JSON record per line
+// and folded into decks.json by compact_decks(). Records carry whole
+// decks, so replaying a record that is already in the snapshot is harmless.
+const size_t deck_journal_compact_bytes = 8 * 1024 * 1024;
+
+string deck_put_record(const string& id, const Deck& deck) {
+    string rec = "{\"op\":\"put\",\"id\":\"";
+    append_json_escaped(rec, id);
+    rec += "\",\"deck\":";
+    append_deck_json(rec, deck);
+    rec += "}\n";
+    return rec;
+}
+
+string deck_delete_record(const string& id) {
+    string rec = "{\"op\":\"delete\",\"id\":\"";
+    append_json_escaped(rec, id);
+    rec += "\"}\n";
+    return rec;
+}
+
+// Applies journal records on top of the loaded snapshot
+size_t replay_deck_journal(Tenant& t) {
+    return replay_journal(get_deck_journal_file(t), [&](string_view line) {
+        JsonReader r(line);
+        string op, id;
+        Deck deck;
+        string_view key;
+        if (r.begin_object()) {
+            while (r.next_key(key)) {
+                if (key == "op") r.read_string(op);
+                else if (key == "id") r.read_string(id);
+                else if (key == "deck" && r.begin_object()) {
+                    while (r.next_key(key)) {
+                        if (!read_deck_field(r, key, deck)) r.skip_value();
+                    }
+                }
+                else r.skip_value();
+            }
+        }
+        if (!r.ok() || id.empty()) return false;
+        if (op == "put") t.decks[id] = std::move(deck);
+        else if (op == "delete") t.decks.erase(id);
+        return true;
+    });
+}
+
+// ==========================================
+// Binary Deck Store
+// ==========================================
+// Optional compact alternative to decks.json (--binary-store). Layout:
+//   BinHeader | BinDeck[deck_count] | BinWord[word_count] | string table
+// Strings are (offset, length) pairs into the string table and identical
+// strings are stored once, so repeated translations and empty hints cost
+// nothing on disk. Loading is a bounds-checked walk over fixed-size
+// records with no parsing or copying: words are views into the mapping,
+// which each deck keeps alive until a save replaces its words. Compaction
+// writes a new file and renames it over the old one, so earlier mappings
+// keep their pages.
+bool use_binary_store = false;
+
+struct BinStr { uint32_t off, len; };
+struct BinHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t deck_count;
+    uint64_t word_count;
+    uint64_t strtab_size;
+};
+struct BinDeck { BinStr id, name, description; uint64_t first_word, word_count; };
+struct BinWord { BinStr word, translation, definition, example, hint; };
+
+const char bin_magic[8] = {'V', 'O', 'C', 'D', 'E', 'C', 'K', '1'};
+
+fs::path get_decks_bin_file(const Tenant& t) { return t.dir / "decks.bin"; }
+
+bool save_decks_binary(Tenant& t) {
+    string strtab;
+    unordered_map<string_view, uint32_t> interned;
+    bool overflow = false;
+    auto intern = [&](string_view str) -> BinStr {
+        if (str.empty()) return {0, 0};
+        auto it = interned.find(str);
+        if (it != interned.end()) return {it->second, (uint32_t)str.size()};
+        if (strtab.size() + str.size() > UINT32_MAX) {
+            overflow = true;
+            return {0, 0};
+        }
+        uint32_t off = (uint32_t)strtab.size();
+        strtab += str;
+        interned.emplace(str, off);
+        return {off, (uint32_t)str.size()};
+    };
+
+    vector<BinDeck> bdecks;
+    vector<BinWord> bwords;
+    bdecks.reserve(t.decks.size());
+    for (const auto& [id, deck] : t.decks) {
+        bdecks.push_back({intern(id), intern(deck.name), intern(deck.description),
+                          bwords.size(), deck.words.size()});
+        for (const auto& w : deck.words) {
+            bwords.push_back({intern(w.word), intern(w.translation), intern(w.definition),
+                              intern(w.example), intern(w.hint)});
+        }
+    }
+    if (overflow) return false;
+
+    BinHeader h{};
+    memcpy(h.magic, bin_magic, sizeof(h.magic));
+    h.version = 1;
+    h.deck_count = (uint32_t)bdecks.size();
+    h.word_count = bwords.size();
+    h.strtab_size = strtab.size();
+
+    string out;
+    out.reserve(sizeof(h) + bdecks.size() * sizeof(BinDeck) + bwords.size() * sizeof(BinWord) + strtab.size());
+    out.append((const char*)&h, sizeof(h));
+    out.append((const char*)bdecks.data(), bdecks.size() * sizeof(BinDeck));
+    out.append((const char*)bwords.data(), bwords.size() * sizeof(BinWord));
+    out += strtab;
+    return write_file_atomic(get_decks_bin_file(t), out);
+}
+
+// Loads decks.bin if it exists and is at least as new as decks.json.
+// Returns false (leaving decks untouched) when absent, stale or corrupt.
+bool load_decks_binary(Tenant& t) {
+    error_code ec;
+    auto bin_time = fs::last_write_time(get_decks_bin_file(t), ec);
+    if (ec) return false;
+    auto json_time = fs::last_write_time(get_decks_file(t), ec);
+    if (!ec && json_time > bin_time) return false;
+
+    auto start = steady_clock::now();
+    auto mf = make_shared<MappedFile>();
+    if (!mf->open(get_decks_bin_file(t))) return false;
+
+    BinHeader h;
+    if (mf->size() < sizeof(h)) return false;
+    memcpy(&h, mf->data(), sizeof(h));
+    uint64_t records = sizeof(h) + (uint64_t)h.deck_count * sizeof(BinDeck) + h.word_count * sizeof(BinWord);
+    if (memcmp(h.magic, bin_magic, sizeof(h.magic)) != 0 || h.version != 1 ||
+        h.word_count > mf->size() / sizeof(BinWord) || records + h.strtab_size != mf->size()) {
+        cout << "Warning: " << get_decks_bin_file(t) << " is corrupt, ignoring it\n";
+        return false;
+    }
+
+    const BinDeck* bdecks = (const BinDeck*)(mf->data() + sizeof(h));
+    const BinWord* bwords = (const BinWord*)(mf->data() + sizeof(h) + h.deck_count * sizeof(BinDeck));
+    string_view strtab(mf->data() + records, h.strtab_size);
+    bool valid = true;
+    auto view = [&](BinStr b) {
+        if ((uint64_t)b.off + b.len > strtab.size()) {
+            valid = false;
+            return string_view();
+        }
+        return strtab.substr(b.off, b.len);
+    };
+    auto str = [&](BinStr b, string& dst) { dst = view(b); };
+
+    map<string, Deck> loaded;
+    string id;
+    for (uint32_t d = 0; d < h.deck_count && valid; d++) {
+        const BinDeck& bd = bdecks[d];
+        if (bd.first_word > h.word_count || bd.word_count > h.word_count - bd.first_word) {
+            valid = false;
+            break;
+        }
+        str(bd.id, id);
+        Deck& deck = loaded[id];
+        str(bd.name, deck.name);
+        str(bd.description, deck.description);
+        deck.text = mf;
+        deck.words.resize(bd.word_count);
+        for (uint64_t i = 0; i < bd.word_count; i++) {
+            const BinWord& bw = bwords[bd.first_word + i];
+            Word& w = deck.words[i];
+            w.word = view(bw.word);
+            w.translation = view(bw.translation);
+            w.definition = view(bw.definition);
+            w.example = view(bw.example);
+            w.hint = view(bw.hint);
+        }
+    }
+    if (!valid) {
+        cout << "Warning: " << get_decks_bin_file(t) << " is corrupt, ignoring it\n";
+        return false;
+    }
+    t.decks = std::move(loaded);
+    t.decks_loaded_from_binary = true;
+
+    double secs = duration<double>(steady_clock::now() - start).count();
+    cout << "Loaded " << t.decks.size() << " decks, " << h.word_count << " words from "
+         << get_decks_bin_file(t).filename() << " in " << fixed << setprecision(1)
+         << secs * 1000 << " ms\n" << defaultfloat;
+    return true;
+}
+
+void load_decks(Tenant& t) {
+    t.decks.clear();
+    if (load_decks_binary(t)) {
+        size_t replayed = replay_deck_journal(t);
+        if (replayed) cout << "Replayed " << replayed << " journal records\n";
+        rebuild_decks_snapshot(t);
+        return;
+    }
+
+    string content;
+    if (!read_whole_file(get_decks_file(t), content)) {
+        // Create sample deck
+        Deck& sample = t.decks["sample"];
+        sample.name = "Spanish Basics";
+        sample.description = "Common Spanish words";
+        pack_words(sample, {
+            {"hola", "hello", "a greeting", "¡Hola! ¿Cómo estás?", ""},
+            {"gracias", "thank you", "expression of gratitude", "Muchas gracias", ""},
+            {"agua", "water", "H2O, liquid for drinking", "Quiero agua", ""},
+            {"casa", "house", "a building for living", "Mi casa es tu casa", ""},
+            {"libro", "book", "written or printed work", "Leo un libro", ""},
+            {"perro", "dog", "domesticated canine", "El perro es grande", ""},
+            {"gato", "cat", "domesticated feline", "El gato duerme", ""},
+            {"tiempo", "time/weather", "duration or atmospheric conditions", "¿Qué tiempo hace?", ""},
+            {"amigo", "friend", "a person you know and like", "Él es mi amigo", ""},
+            {"comida", "food", "something to eat", "La comida está lista", ""}
+        });
+        size_t replayed = replay_deck_journal(t);
+        if (replayed) cout << "Replayed " << replayed << " journal records\n";
+        rebuild_decks_snapshot(t);
+        return;
+    }
+
+    auto start = steady_clock::now();
+    size_t word_count = 0;
+
+    // { "<id>": { "name": ..., "description": ..., "words": [ {..}, .. ] }, .. }
+    JsonReader r(content);
+    string_view key;
+    if (r.begin_object()) {
+        while (r.next_key(key)) {
+            Deck& deck = t.decks[string(key)];
+            deck = Deck();
+            if (!r.begin_object()) {
+                r.skip_value();
+                continue;
+            }
+            while (r.next_key(key)) {
+                if (!read_deck_field(r, key, deck)) r.skip_value();
+            }
+            word_count += deck.words.size();
+        }
+    }
+    if (!r.ok()) {
+        cout << "Warning: " << get_decks_file(t) << " is malformed near offset " << r.offset()
+             << ", loaded what could be read\n";
+    }
+
+    double secs = duration<double>(steady_clock::now() - start).count();
+    double mb = content.size() / (1024.0 * 1024.0);
+    cout << "Loaded " << t.decks.size() << " decks, " << word_count << " words ("
+         << fixed << setprecision(1) << mb << " MB) in " << secs * 1000 << " ms ("
+         << (secs > 0 ? mb / secs : 0.0) << " MB/s)\n" << defaultfloat;
+
+    size_t replayed = replay_deck_journal(t);
+    if (replayed) cout << "Replayed " << replayed << " journal records\n";
+    rebuild_decks_snapshot(t);
+}
+
+// Writes the full deck map to decks.json (or decks.bin with --binary-store)
+// via a temp file and atomic rename
+bool save_decks(Tenant& t) {
+    if (use_binary_store) return save_decks_binary(t);
+    ostringstream file;
+    file << "{\n";
+    bool first = true;
+    for (const auto& [id, deck] : t.decks) {
+        if (!first) file << ",\n";
+        first = false;
+        file << "  \"" << escape_json(id) << "\": {\n";
+        file << "    \"name\": \"" << escape_json(deck.name) << "\",\n";
+        file << "    \"description\": \"" << escape_json(deck.description) << "\",\n";
+        file << "    \"words\": [\n";
+        for (size_t i = 0; i < deck.words.size(); i++) {
+            const auto& w = deck.words[i];
+            file << "      {\"word\": \"" << escape_json(w.word) 
+                 << "\", \"translation\": \"" << escape_json(w.translation)
+                 << "\", \"definition\": \"" << escape_json(w.definition)
+                 << "\", \"example\": \"" << escape_json(w.example)
+                 << "\", \"hint\": \"" << escape_json(w.hint) << "\"}";
+            if (i < deck.words.size() - 1) file << ",";
+            file << "\n";
+        }
+        file << "    ]\n  }";
+    }
+    file << "\n}\n";
+    return write_file_atomic(get_decks_file(t), file.str());
+}
+
+// Folds the journal into a fresh decks.json. Holding the shared lock keeps
+// writers (who append under the exclusive lock) out, so once the journal
+// is flushed the snapshot covers every record in it.
+void compact_decks(Tenant& t) {
+    shared_lock lock(t.decks_mutex);
+    t.deck_journal.flush();
+    if (save_decks(t)) t.deck_journal.truncate();
+    else cout << "Warning: failed to write " << (use_binary_store ? get_decks_bin_file(t) : get_decks_file(t)) << "\n";
+}
+
+// sessions.bin is a sequence of checksummed blocks:
+//   SessionBlockHeader | records
+// and each record is
+//   i64 timestamp, i32 correct, i32 total, i32 score,
+//   u16 deck length, deck bytes, u16 mode length, mode bytes
+// Strings are length-prefixed, so deck names may contain spaces. A block
+// whose checksum does not match (a torn append) ends the log.
+struct SessionBlockHeader {
+    uint32_t magic;
+    uint32_t count;
+    uint32_t payload_size;
+    uint32_t crc;
+};
+const uint32_t session_block_magic = 0x31425356;  // "VSB1"
+
+fs::path get_sessions_bin_file(const Tenant& t) { return t.dir / "sessions.bin"; }
+
+// Completed sessions are handed to this log and written by its thread, one
+// block per batch. With --sync-sessions each batch is fdatasync'd and the
+// request waits for it; otherwise the handler returns once queued.
+bool sync_sessions = false;
+const size_t session_queue_capacity = 4096;
+
+uint32_t crc32(const char* data, size_t len) {
+    static uint32_t table[256];
+    static bool init = [] {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        return true;
+    }();
+    (void)init;
+    uint32_t c = 0xFFFFFFFFu;
+    for (size_t i = 0; i < len; i++) c = table[(c ^ (unsigned char)data[i]) & 0xFF] ^ (c >> 8);
+    return c ^ 0xFFFFFFFFu;
+}
+
+void append_session_record(string& out, const Session& s) {
+    auto put = [&](const void* p, size_t n) { out.append((const char*)p, n); };
+    int64_t ts = s.timestamp;
+    int32_t nums[3] = {s.correct, s.total, s.score};
+    uint16_t deck_len = (uint16_t)min<size_t>(s.deck.size(), UINT16_MAX);
+    uint16_t mode_len = (uint16_t)min<size_t>(s.mode.size(), UINT16_MAX);
+    put(&ts, sizeof(ts));
+    put(nums, sizeof(nums));
+    put(&deck_len, sizeof(deck_len));
+    put(s.deck.data(), deck_len);
+    put(&mode_len, sizeof(mode_len));
+    put(s.mode.data(), mode_len);
+}
+
+// Wraps already-encoded records in a block header
+string make_session_block(const string& payload, uint32_t count) {
+    SessionBlockHeader h{session_block_magic, count, (uint32_t)payload.size(), crc32(payload.data(), payload.size())};
+    string block((const char*)&h, sizeof(h));
+    block += payload;
+    return block;
+}
+
+// Decodes every intact block; returns the number of bytes that were valid
+size_t read_session_blocks(const char* data, size_t size, vector<Session>& out) {
+    size_t pos = 0;
+    while (size - pos >= sizeof(SessionBlockHeader)) {
+        SessionBlockHeader h;
+        memcpy(&h, data + pos, sizeof(h));
+        if (h.magic != session_block_magic || h.payload_size > size - pos - sizeof(h)) break;
+        const char* p = data + pos + sizeof(h);
+        const char* end = p + h.payload_size;
+        if (crc32(p, h.payload_size) != h.crc) break;
+
+        bool ok = true;
+        auto get = [&](void* dst, size_t n) {
+            if ((size_t)(end - p) < n) { ok = false; return; }
+            memcpy(dst, p, n);
+            p += n;
+        };
+        auto get_str = [&](string& dst) {
+            uint16_t len = 0;
+            get(&len, sizeof(len));
+            if (!ok || (size_t)(end - p) < len) { ok = false; return; }
+            dst.assign(p, len);
+            p += len;
+        };
+        for (uint32_t i = 0; i < h.count && ok; i++) {
+            Session& s = out.emplace_back();
+            int64_t ts = 0;
+            int32_t nums[3] = {0, 0, 0};
+            get(&ts, sizeof(ts));
+            get(nums, sizeof(nums));
+            get_str(s.deck);
+            get_str(s.mode);
+            s.timestamp = ts;
+            s.correct = nums[0];
+            s.total = nums[1];
+            s.score = nums[2];
+            if (!ok) out.pop_back();
+        }
+        if (!ok) break;
+        pos += sizeof(h) + h.payload_size;
+    }
+    return pos;
+}
+
+// Parses the legacy whitespace-separated sessions.txt
+vector<Session> read_sessions_text(const fs::path& path) {
+    vector<Session> result;
+    ifstream file(path);
+    string line;
+    while (getline(file, line)) {
+        istringstream iss(line);
+        Session s;
+        if (iss >> s.timestamp >> s.deck >> s.correct >> s.total >> s.score >> s.mode) {
+            result.push_back(s);
+        }
+    }
+    return result;
+}
+
+// One-shot conversion of sessions.txt into sessions.bin. The text file is
+// kept as sessions.txt.migrated.
+bool migrate_sessions_text(Tenant& t) {
+    if (!fs::exists(get_sessions_file(t))) return false;
+    vector<Session> old = read_sessions_text(get_sessions_file(t));
+    string payload;
+    for (const auto& s : old) append_session_record(payload, s);
+    string data = old.empty() ? string() : make_session_block(payload, (uint32_t)old.size());
+    if (!write_file_atomic(get_sessions_bin_file(t), data)) {
+        cout << "Warning: failed to write " << get_sessions_bin_file(t) << "\n";
+        return false;
+    }
+    error_code ec;
+    fs::path done = get_sessions_file(t);
+    done += ".migrated";
+    fs::rename(get_sessions_file(t), done, ec);
+    cout << "Migrated " << old.size() << " sessions from " << get_sessions_file(t).filename()
+         << " to " << get_sessions_bin_file(t).filename() << "\n";
+    return true;
+}
+
+// Writes sessions in the legacy text format (--export-sessions)
+bool export_sessions_text(Tenant& t, const fs::path& path) {
+    ostringstream out;
+    for (const auto& s : t.sessions) {
+        out << s.timestamp << " " << s.deck << " " << s.correct << " "
+            << s.total << " " << s.score << " " << s.mode << "\n";
+    }
+    return write_file_atomic(path, out.str());
+}
+
+void load_sessions(Tenant& t) {
+    t.sessions.clear();
+    if (!fs::exists(get_sessions_bin_file(t))) migrate_sessions_text(t);
+
+    auto start = steady_clock::now();
+    MappedFile mf;
+    if (mf.open(get_sessions_bin_file(t))) {
+        t.sessions.reserve(mf.size() / 32);
+        size_t valid = read_session_blocks(mf.data(), mf.size(), t.sessions);
+        if (valid != mf.size()) {
+            cout << "Warning: " << get_sessions_bin_file(t) << " has a damaged tail at offset " << valid
+                 << ", truncating it\n";
+            error_code ec;
+            fs::resize_file(get_sessions_bin_file(t), valid, ec);
+        }
+    }
+    auto by_time = [](const Session& a, const Session& b) { return a.timestamp < b.timestamp; };
+    if (!is_sorted(t.sessions.begin(), t.sessions.end(), by_time)) {
+        stable_sort(t.sessions.begin(), t.sessions.end(), by_time);
+    }
+    t.sessions_by_deck.clear();
+    t.sessions_by_mode.clear();
+    t.stats_overall = SessionStats();
+    t.stats_by_deck.clear();
+    t.stats_by_mode.clear();
+    t.stats_by_day.clear();
+    for (size_t i = 0; i < t.sessions.size(); i++) {
+        index_session(t, i);
+        aggregate_session(t, t.sessions[i]);
+    }
+    t.session_count = t.sessions.size();
+    if (!t.sessions.empty()) {
+        double secs = duration<double>(steady_clock::now() - start).count();
+        cout << "Loaded " << t.sessions.size() << " sessions in " << fixed << setprecision(1)
+             << secs * 1000 << " ms\n" << defaultfloat;
+    }
+}
+
+void open_session_log(Tenant& t) {
+    // Each queued record is one encoded session; a batch becomes one block
+    t.session_log.open(get_sessions_bin_file(t), sync_sessions, session_queue_capacity,
+        [](const vector<string>& batch, string& out) {
+            string payload;
+            for (const auto& rec : batch) payload += rec;
+            out = make_session_block(payload, (uint32_t)batch.size());
+        });
+}
+
+// False when the session could not be written. With --sync-sessions it is
+// only published once its block is on disk; otherwise it is queued and
+// acknowledged at once. Sessions are independent, so concurrent saves
+// still share a block.
+bool save_session(Tenant& t, Session s) {
+    string record;
+    append_session_record(record, s);
+    if (sync_sessions && !t.session_log.wait_durable(t.session_log.append(std::move(record)))) return false;
+    {
+        unique_lock lock(t.sessions_mutex);
+        // Keep the vector timestamp-ordered even if the clock steps backwards
+        if (!t.sessions.empty() && s.timestamp < t.sessions.back().timestamp) s.timestamp = t.sessions.back().timestamp;
+        t.sessions.push_back(s);
+        t.session_count = t.sessions.size();
+        index_session(t, t.sessions.size() - 1);
+        aggregate_session(t, s);
+    }
+    if (!sync_sessions) t.session_log.append(std::move(record));
+    return true;
+}
+
+// ==========================================
+// Review Scheduler
+// ==========================================
+// Reviews are appended to reviews.journal as one JSON line each and folded
+// into progress.json by compact_progress(). Both identify words by text
+// rather than position, so they stay valid when a deck is edited.
+const size_t review_journal_compact_bytes = 4 * 1024 * 1024;
+
+fs::path get_progress_file(const Tenant& t) { return t.dir / "progress.json"; }
+fs::path get_review_journal_file(const Tenant& t) { return t.dir / "reviews.journal"; }
+
+// Refreshes the card count behind Tenant::memory(); schedules_mutex held
+void count_cards(Tenant& t) {
+    size_t n = 0;
+    for (const auto& [id, sched] : t.schedules) n += sched.cards.size();
+    t.card_count = n;
+}
+
+DeckSchedule& schedule_for(Tenant& t, const string& id, const Deck& deck) {
+    DeckSchedule& sched = t.schedules[id];
+    if (sched.cards.size() != deck.words.size()) {
+        vector<CardState> states = std::move(sched.cards);
+        states.resize(deck.words.size());
+        sched.assign(std::move(states));
+        count_cards(t);
+    }
+    return sched;
+}
+
+// Carries review state over to a new version of a deck, matching words by
+// text. Called with both locks held, before decks[id] is replaced.
+void remap_schedule(Tenant& t, const string& id, const vector<Word>& old_words, const vector<Word>& new_words) {
+    auto it = t.schedules.find(id);
+    if (it == t.schedules.end()) return;
+    unordered_map<string_view, CardState> by_word;
+    for (size_t i = 0; i < old_words.size() && i < it->second.cards.size(); i++) {
+        if (it->second.cards[i].due) by_word.emplace(old_words[i].word, it->second.cards[i]);
+    }
+    vector<CardState> states(new_words.size());
+    for (size_t i = 0; i < new_words.size(); i++) {
+        auto found = by_word.find(new_words[i].word);
+        if (found != by_word.end()) states[i] = found->second;
+    }
+    it->second.assign(std::move(states));
+    count_cards(t);
+}
+
+string review_record(const string& deck, string_view word, int rating, long long time, long long response_ms) {
+    string rec = "{\"deck\":\"";
+    append_json_escaped(rec, deck);
+    rec += "\",\"word\":\"";
+    append_json_escaped(rec, word);
+    rec += "\",\"rating\":" + to_string(rating);
+    rec += ",\"time\":" + to_string(time);
+    rec += ",\"ms\":" + to_string(response_ms) + "}\n";
+    return rec;
+}
+
+// Word text -> first position, for resolving persisted state
+unordered_map<string_view, uint32_t> word_positions(const Deck& deck) {
+    unordered_map<string_view, uint32_t> index;
+    index.reserve(deck.words.size());
+    for (uint32_t i = 0; i < deck.words.size(); i++) index.emplace(deck.words[i].word, i);
+    return index;
+}
+
+// progress.json maps deck id -> word -> [due, interval, ease, reps, lapses].
+// Entries for decks or words that no longer exist are dropped.
+void load_progress_snapshot(Tenant& t) {
+    string content;
+    if (!read_whole_file(get_progress_file(t), content)) return;
+    JsonReader r(content);
+    string_view key;
+    string deck_id, word;
+    if (!r.begin_object()) return;
+    while (r.next_key(key)) {
+        deck_id = key;
+        auto deck = t.decks.find(deck_id);
+        if (deck == t.decks.end() || !r.begin_object()) {
+            r.skip_value();
+            continue;
+        }
+        auto positions = word_positions(deck->second);
+        vector<CardState> states(deck->second.words.size());
+        while (r.next_key(key)) {
+            word = key;
+            CardState c;
+            long long v[5] = {0, 0, 2500, 0, 0};
+            if (r.begin_array()) {
+                for (int k = 0; r.next_element(); k++) {
+                    if (k < 5) r.read_int(v[k]);
+                    else r.skip_value();
+                }
+            } else {
+                r.skip_value();
+            }
+            c.due = v[0];
+            c.interval = (uint32_t)clamp(v[1], 0LL, (long long)UINT32_MAX);
+            c.ease = (uint16_t)clamp(v[2], 1300LL, 5000LL);
+            c.reps = (uint16_t)clamp(v[3], 0LL, (long long)UINT16_MAX);
+            c.lapses = (uint16_t)clamp(v[4], 0LL, (long long)UINT16_MAX);
+            auto p = positions.find(word);
+            if (p != positions.end() && c.due > 0) states[p->second] = c;
+        }
+        t.schedules[deck_id].assign(std::move(states));
+    }
+    if (!r.ok()) cout << "Warning: " << get_progress_file(t) << " is damaged; review state may be incomplete\n";
+}
+
+// Applies journal records in order
+size_t replay_review_journal(Tenant& t) {
+    unordered_map<string, unordered_map<string_view, uint32_t>> positions;
+    return replay_journal(get_review_journal_file(t), [&](string_view line) {
+        JsonReader r(line);
+        string deck_id, word;
+        int rating = -1;
+        long long time = 0;
+        string_view key;
+        if (r.begin_object()) {
+            while (r.next_key(key)) {
+                if (key == "deck") r.read_string(deck_id);
+                else if (key == "word") r.read_string(word);
+                else if (key == "rating") r.read_int(rating);
+                else if (key == "time") r.read_int(time);
+                else r.skip_value();
+            }
+        }
+        if (!r.ok() || rating < 0) return false;
+
+        auto deck = t.decks.find(deck_id);
+        if (deck == t.decks.end()) return true;
+        auto& index = positions[deck_id];
+        if (index.empty()) index = word_positions(deck->second);
+        auto p = index.find(word);
+        if (p == index.end()) return true;
+        DeckSchedule& sched = schedule_for(t, deck_id, deck->second);
+        apply_review(sched.cards[p->second], rating, time);
+        sched.updated(p->second);
+        return true;
+    });
+}
+
+void load_progress(Tenant& t) {
+    load_progress_snapshot(t);
+    size_t replayed = replay_review_journal(t);
+    if (replayed) cout << "Replayed " << replayed << " review records\n";
+    count_cards(t);
+}
+
+bool save_progress(Tenant& t) {
+    string json = "{";
+    bool first_deck = true;
+    for (const auto& [id, sched] : t.schedules) {
+        auto deck = t.decks.find(id);
+        if (deck == t.decks.end()) continue;
+        if (!first_deck) json += ",\n";
+        first_deck = false;
+        json += '"'; append_json_escaped(json, id); json += "\":{";
+        bool first = true;
+        for (size_t i = 0; i < sched.cards.size() && i < deck->second.words.size(); i++) {
+            const CardState& c = sched.cards[i];
+            if (!c.due) continue;
+            if (!first) json += ',';
+            first = false;
+            json += '"'; append_json_escaped(json, deck->second.words[i].word); json += "\":[";
+            json += to_string(c.due) + ',' + to_string(c.interval) + ',' + to_string(c.ease) + ',' +
+                    to_string(c.reps) + ',' + to_string(c.lapses) + ']';
+        }
+        json += '}';
+    }
+    json += "}\n";
+    return write_file_atomic(get_progress_file(t), json);
+}
+
+// Folds the review journal into progress.json. Reviewers append under the
+// exclusive schedules lock, so the shared lock keeps them out meanwhile.
+void compact_progress(Tenant& t) {
+    shared_lock decks_lock(t.decks_mutex);
+    shared_lock lock(t.schedules_mutex);
+    t.review_journal.flush();
+    if (save_progress(t)) t.review_journal.truncate();
+    else cout << "Warning: failed to write " << get_progress_file(t) << "\n";
+}
+
+struct ReviewEvent {
+    string deck;
+    long long word = -1;
+    string text;  // the word itself, to catch positions gone stale
+    bool has_text = false;
+    int rating = -1;
+    long long time = 0;
+    long long response_ms = 0;
+};
+
+// Reads {"deck":"id","word":<position>,"text":"word","rating":0-3,"time":ms,
+// "response_time_ms":n}; false, with the value skipped, when it is not an
+// object. text is the card's word as handed out by /api/next-cards, and
+// time is when it was answered, in ms since the epoch.
+bool read_review_event(JsonReader& r, ReviewEvent& e) {
+    string_view key;
+    if (!r.begin_object()) {
+        r.skip_value();
+        return false;
+    }
+    while (r.next_key(key)) {
+        if (key == "deck") r.read_string(e.deck);
+        else if (key == "word") r.read_int(e.word);
+        else if (key == "text") e.has_text = r.read_string(e.text);
+        else if (key == "rating") r.read_int(e.rating);
+        else if (key == "time") r.read_int(e.time);
+        else if (key == "response_time_ms") r.read_int(e.response_ms);
+        else r.skip_value();
+    }
+    return true;
+}
+
+// Applies a batch of reviews as a unit once it is persisted with one
+// journal append. The schedules lock is held throughout, so nothing sees
+// reviews that fail to store. When an event's text no longer matches the
+// word at its position, the deck was edited after the card was handed out
+// and the word is looked up by text instead. If any event names an unknown
+// card or rating, its position is added to rejected and nothing is
+// applied. Each review is scheduled from its answer time, or from now when
+// that is missing or in the future. False when the journal write failed.
+bool apply_reviews(Tenant& t, const vector<ReviewEvent>& events, vector<size_t>& rejected) {
+    shared_lock lock(t.decks_mutex);
+    struct Target {
+        const string* id = nullptr;
+        const Deck* deck = nullptr;
+        uint32_t word = 0;
+    };
+    vector<Target> targets(events.size());
+    unordered_map<const Deck*, unordered_map<string_view, uint32_t>> positions;
+    for (size_t i = 0; i < events.size(); i++) {
+        const ReviewEvent& e = events[i];
+        auto it = t.decks.find(e.deck);
+        if (it == t.decks.end() || e.rating < 0 || e.rating > 3) {
+            rejected.push_back(i);
+            continue;
+        }
+        const auto& words = it->second.words;
+        long long word = e.word;
+        bool stale = word < 0 || word >= (long long)words.size() || (e.has_text && words[word].word != e.text);
+        if (stale && e.has_text) {
+            auto& index = positions[&it->second];
+            if (index.empty()) index = word_positions(it->second);
+            auto p = index.find(e.text);
+            word = p == index.end() ? -1LL : (long long)p->second;
+        } else if (stale) {
+            word = -1;
+        }
+        if (word < 0) {
+            rejected.push_back(i);
+            continue;
+        }
+        targets[i] = {&it->first, &it->second, (uint32_t)word};
+    }
+    if (!rejected.empty()) return true;
+
+    long long now = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+    vector<long long> times(events.size());
+    string records;
+    for (size_t i = 0; i < events.size(); i++) {
+        const auto& [id, deck, word] = targets[i];
+        times[i] = events[i].time > 0 && events[i].time <= now ? events[i].time : now;
+        records += review_record(*id, deck->words[word].word, events[i].rating, times[i], events[i].response_ms);
+    }
+    if (records.empty()) return true;
+
+    unique_lock sched_lock(t.schedules_mutex);
+    if (!t.review_journal.wait_durable(t.review_journal.append(std::move(records)))) return false;
+    for (size_t i = 0; i < events.size(); i++) {
+        const auto& [id, deck, word] = targets[i];
+        DeckSchedule& sched = schedule_for(t, *id, *deck);
+        apply_review(sched.cards[word], events[i].rating, times[i]);
+        sched.updated(word);
+    }
+    return true;
+}
+
+// ==========================================
+// Deck Import
+// ==========================================
+// Saving a deck drops exact duplicate words and reports words that already
+// exist elsewhere (see Duplicate Detection); /api/save-deck and
+// /api/import share it.
+
+// Stores the deck and appends its "removed" and "conflicts" members to
+// json. The deck is only published once its journal record is on disk,
+// under the exclusive lock throughout, so a failed write leaves nothing
+// behind. False when the journal write failed.
+bool save_deck(Tenant& t, const string& id, Deck deck, string& json) {
+    auto removed = drop_duplicate_words(deck);
+    json += ",\"removed\":[";
+    for (size_t i = 0; i < removed.size(); i++) {
+        if (i > 0) json += ',';
+        json += "{\"id\":" + to_string(removed[i].first) + ",\"of\":" + to_string(removed[i].second) + "}";
+    }
+    json += "],\"conflicts\":[";
+
+    build_deck_index(t, t.duplicates, t.duplicate_bytes, t.duplicates_build_mutex);
+    {
+        unique_lock lock(t.decks_mutex);
+        if (!t.deck_journal.wait_durable(t.deck_journal.append(deck_put_record(id, deck)))) return false;
+        {
+            unique_lock sched_lock(t.schedules_mutex);
+            auto old = t.decks.find(id);
+            if (old != t.decks.end()) remap_schedule(t, id, old->second.words, deck.words);
+        }
+        const Deck& saved = t.decks[id] = std::move(deck);
+        if (t.search.built()) {
+            t.search.put_deck(id, saved);
+            t.search_bytes = t.search.memory();
+        }
+        auto conflicts = t.duplicates.put_deck(id, saved);
+        t.duplicate_bytes = t.duplicates.memory();
+        for (size_t i = 0; i < conflicts.size(); i++) {
+            const auto& c = conflicts[i];
+            if (i > 0) json += ',';
+            json += "{\"id\":" + to_string(c.pos) + ",\"deck\":\"";
+            append_json_escaped(json, *c.deck);
+            json += "\",\"other\":" + to_string(c.other) + ",\"distance\":" + to_string(c.distance) + "}";
+        }
+        rebuild_decks_snapshot(t);
+    }
+    json += ']';
+    return true;
+}
+
+// Splits a deck upload into word records as it streams in, so the body is
+// never held whole. JSON uploads look like the save-deck body; each
+// element of "words" becomes one record and everything else is kept in
+// head, with an empty words array, for parsing at the end. TSV uploads
+// are one "word<TAB>translation<TAB>definition" record per line.
+class DeckStream {
+public:
+    static constexpr size_t max_head = 64 * 1024;
+    static constexpr size_t max_record = 64 * 1024;
+
+    DeckStream(bool tsv, function<void(string&&)> on_record) : tsv(tsv), on_record(std::move(on_record)) {}
+
+    // False once the upload cannot be a deck
+    bool feed(const char* data, size_t n) {
+        for (size_t i = 0; i < n && !failed;) {
+            if (!tsv && in_words && depth > 2 && !escape) {
+                // Copy the run up to the next character that changes state
+                size_t j = i;
+                if (in_string) {
+                    while (j < n && data[j] != '"' && data[j] != '\\') j++;
+                } else {
+                    while (j < n && data[j] != '"' && data[j] != '{' && data[j] != '}' && data[j] != '[' && data[j] != ']') j++;
+                }
+                record.append(data + i, j - i);
+                failed = record.size() > max_record;
+                i = j;
+                if (i == n) break;
+            }
+            tsv ? feed_tsv(data[i]) : feed_json(data[i]);
+            i++;
+        }
+        return !failed;
+    }
+
+    bool finish() {
+        if (tsv && !record.empty()) emit();
+        return !failed && (tsv || (depth == 0 && started));
+    }
+
+    bool ok() const { return !failed; }
+    const string& head_json() const { return head; }
+
+private:
+    bool tsv;
+    function<void(string&&)> on_record;
+    string head;
+    string record;
+    string key;  // last string seen at the top level
+    int depth = 0;
+    bool started = false;
+    bool in_string = false;
+    bool escape = false;
+    bool in_words = false;
+    bool failed = false;
+
+    void emit() {
+        on_record(std::move(record));
+        record.clear();
+    }
+
+    void feed_tsv(char c) {
+        if (c == '\n') {
+            if (!record.empty()) emit();
+        } else if (c != '\r') {
+            record.push_back(c);
+            failed = record.size() > max_record;
+        }
+    }
+
+    void feed_json(char c) {
+        bool structural = !in_string;
+        if (in_string) {
+            if (escape) escape = false;
+            else if (c == '\\') escape = true;
+            else if (c == '"') in_string = false;
+        } else if (c == '"') {
+            in_string = true;
+            if (depth == 1 && !in_words) key.clear();
+        } else if (c == '{' || c == '[') {
+            started = true;
+            depth++;
+        } else if (c == '}' || c == ']') {
+            failed = --depth < 0;
+        }
+
+        if (!in_words) {
+            if (in_string && depth == 1 && c != '"') key.push_back(c);
+            head.push_back(c);
+            failed |= head.size() > max_head;
+            if (structural && c == '[' && depth == 2 && key == "words") in_words = true;
+            return;
+        }
+        if (depth == 1) {
+            // The array closed
+            head.push_back(c);
+            in_words = false;
+        } else if (depth > 2 || (structural && c == '}')) {
+            record.push_back(c);
+            failed = record.size() > max_record;
+            if (depth == 2) emit();
+        } else if (!(c == ',' || c == ' ' || c == '\n' || c == '\r' || c == '\t')) {
+            failed = true;  // words must be objects
+        }
+    }
+};
+
+// Trims surrounding whitespace from every field; false when there is no word
+bool normalize_word(WordFields& w) {
+    for (string* f : {&w.word, &w.translation, &w.definition, &w.example, &w.hint}) {
+        size_t b = f->find_first_not_of(" \t\r\n");
+        if (b == string::npos) {
+            f->clear();
+            continue;
+        }
+        size_t e = f->find_last_not_of(" \t\r\n");
+        if (b > 0 || e + 1 < f->size()) *f = f->substr(b, e - b + 1);
+    }
+    return !w.word.empty();
+}
+
+struct ImportResult {
+    Deck deck;
+    size_t skipped = 0;  // records without a word
+    string error;
+};
+
+// Parses import batches for every upload, one thread per core. Never
+// destroyed, like the log writers.
+const size_t import_workers = max(1u, thread::hardware_concurrency());
+httplib::ThreadPool& import_pool() {
+    static httplib::ThreadPool* pool = new httplib::ThreadPool(import_workers);
+    return *pool;
+}
+
+// Reads a deck upload. Records are parsed and normalized on the shared
+// import pool in batches, at most a few batches ahead of the reader so
+// memory stays bounded by the deck itself, then joined in upload order.
+// progress gets the bytes and records read so far.
+ImportResult import_deck(const httplib::ContentReader& content_reader, bool tsv,
+                         const function<void(size_t, size_t)>& progress) {
+    const size_t batch_size = 1024;
+
+    struct Batch {
+        vector<string> records;
+        vector<WordFields> words;
+        size_t skipped = 0;
+        bool malformed = false;
+    };
+    deque<Batch> batches;  // stable addresses while workers fill them
+    mutex m;
+    condition_variable cv;
+    size_t in_flight = 0;
+
+    auto parse_batch = [tsv](Batch& b) {
+        b.words.reserve(b.records.size());
+        for (const string& rec : b.records) {
+            WordFields w;
+            if (tsv) {
+                size_t tab1 = rec.find('\t');
+                size_t tab2 = tab1 == string::npos ? string::npos : rec.find('\t', tab1 + 1);
+                w.word = rec.substr(0, tab1);
+                if (tab1 != string::npos) w.translation = rec.substr(tab1 + 1, tab2 - tab1 - 1);
+                if (tab2 != string::npos) w.definition = rec.substr(tab2 + 1);
+            } else {
+                JsonReader r(rec);
+                if (r.begin_object()) read_word(r, w);
+                if (!r.ok()) {
+                    b.malformed = true;
+                    break;
+                }
+            }
+            if (normalize_word(w)) b.words.push_back(std::move(w));
+            else b.skipped++;
+        }
+        b.records.clear();
+        b.records.shrink_to_fit();
+    };
+    auto dispatch = [&] {
+        Batch& b = batches.back();
+        unique_lock lock(m);
+        cv.wait(lock, [&] { return in_flight < 2 * import_workers; });
+        in_flight++;
+        import_pool().enqueue([&, batch = &b] {
+            parse_batch(*batch);
+            lock_guard lock(m);
+            in_flight--;
+            cv.notify_all();
+        });
+    };
+
+    size_t bytes = 0, records = 0;
+    batches.emplace_back();
+    DeckStream stream(tsv, [&](string&& rec) {
+        records++;
+        batches.back().records.push_back(std::move(rec));
+        if (batches.back().records.size() == batch_size) {
+            dispatch();
+            batches.emplace_back();
+        }
+    });
+    bool read = content_reader([&](const char* data, size_t n) {
+        bytes += n;
+        bool ok = stream.feed(data, n);
+        progress(bytes, records);
+        return ok;
+    });
+    bool complete = read && stream.finish();
+    if (complete && !batches.back().records.empty()) dispatch();
+    {
+        // The batches refer to this frame
+        unique_lock lock(m);
+        cv.wait(lock, [&] { return in_flight == 0; });
+    }
+
+    ImportResult result;
+    if (!complete) {
+        result.error = read || !stream.ok() ? "malformed deck" : "upload interrupted";
+        return result;
+    }
+    size_t total = 0;
+    for (const Batch& b : batches) {
+        if (b.malformed) {
+            result.error = "malformed word";
+            return result;
+        }
+        total += b.words.size();
+        result.skipped += b.skipped;
+    }
+    vector<WordFields> words;
+    words.reserve(total);
+    for (Batch& b : batches) {
+        move(b.words.begin(), b.words.end(), back_inserter(words));
+        vector<WordFields>().swap(b.words);
+    }
+    pack_words(result.deck, words);
+    if (!tsv) {
+        JsonReader r(stream.head_json());
+        string_view key;
+        Deck head;
+        if (r.begin_object()) {
+            while (r.next_key(key)) {
+                if (!read_deck_field(r, key, head)) r.skip_value();
+            }
+        }
+        if (!r.ok()) {
+            result.error = "malformed deck";
+            return result;
+        }
+        result.deck.name = std::move(head.name);
+        result.deck.description = std::move(head.description);
+    }
+    progress(bytes, records);
+    return result;
+}
+
+// ==========================================
+// Tenant Registry
+// ==========================================
+// Each learner (tenant) is named by a key sent with every API request, as
+// the X-Vocalo-User header or a user= query parameter. Requests without
+// one use the default tenant, whose files sit directly in the data
+// directory; the others live under users/<key>/. Keys are case-insensitive
+// and lower-cased, so "Alice" and "alice" are one learner on every
+// filesystem. Tenants are loaded on first use and kept in LRU order. When
+// the estimated size of all loaded tenants exceeds --memory-budget, the
+// least recently used ones that no request is holding are compacted and
+// unloaded. The most recently used one always stays, even on its own over
+// the budget, so a large tenant is not reloaded on every request. Loaded
+// tenants hold no files open (see Group Commit Log), so descriptors do not
+// limit how many can be loaded.
+size_t memory_budget = 256 * 1024 * 1024;
+mutex tenants_mutex;
+condition_variable tenants_cv;
+list<shared_ptr<Tenant>> tenant_lru;  // most recently used first
+unordered_map<string, list<shared_ptr<Tenant>>::iterator> tenants;
+unordered_set<string> tenants_closing;
+
+// 1-64 characters from [A-Za-z0-9_.-], not starting with a dot. Callers
+// lower-case the key before use.
+bool valid_tenant_key(const string& key) {
+    if (key.empty() || key.size() > 64 || key[0] == '.') return false;
+    for (char c : key) {
+        if (!isalnum((unsigned char)c) && c != '_' && c != '.' && c != '-') return false;
+    }
+    return true;
+}
+
+// Keys used to keep their case, so users/Alice may exist from before.
+// Adopts such a directory when it is the only case-insensitive match.
+void adopt_mixed_case_dir(const Tenant& t) {
+    error_code ec;
+    if (t.key.empty() || fs::exists(t.dir, ec)) return;
+    vector<fs::path> matches;
+    for (const auto& entry : fs::directory_iterator(t.dir.parent_path(), ec)) {
+        string name = entry.path().filename().string();
+        transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return (char)tolower(c); });
+        if (name == t.key) matches.push_back(entry.path());
+    }
+    if (matches.size() == 1) {
+        fs::rename(matches[0], t.dir, ec);
+        if (!ec) cout << "Renamed " << matches[0] << " to " << t.dir << "\n";
+    } else if (matches.size() > 1) {
+        cout << "Warning: several directories match user " << t.key << "; starting " << t.dir << " empty\n";
+    }
+}
+
+void load_tenant(Tenant& t) {
+    error_code ec;
+    adopt_mixed_case_dir(t);
+    fs::create_directories(t.dir, ec);
+    load_decks(t);
+    load_sessions(t);
+    load_progress(t);
+    open_session_log(t);
+    t.deck_journal.open(get_deck_journal_file(t));
+    t.review_journal.open(get_review_journal_file(t));
+    // Also rewrite the snapshot when switching between JSON and binary stores
+    if (t.deck_journal.size() > 0 || use_binary_store != t.decks_loaded_from_binary) compact_decks(t);
+    if (t.review_journal.size() > 0) compact_progress(t);
+    t.ready = true;
+}
+
+// Folds the journals so the next load is a plain snapshot read. The logs
+// themselves drain when the tenant is destroyed.
+void unload_tenant(Tenant& t) {
+    if (t.deck_journal.size() > 0) compact_decks(t);
+    if (t.review_journal.size() > 0) compact_progress(t);
+}
+
+void enforce_memory_budget() {
+    vector<shared_ptr<Tenant>> victims;
+    {
+        lock_guard lock(tenants_mutex);
+        size_t total = 0;
+        for (const auto& t : tenant_lru) total += t->memory();
+        // Stops short of the front: the most recently used tenant stays
+        for (auto it = tenant_lru.end(); total > memory_budget && it != tenant_lru.begin();) {
+            if (--it == tenant_lru.begin()) break;
+            // New references are only handed out under tenants_mutex, so a
+            // tenant held by nothing but the LRU list is idle
+            if (it->use_count() > 1 || !(*it)->ready) continue;
+            total -= (*it)->memory();
+            tenants.erase((*it)->key);
+            tenants_closing.insert((*it)->key);
+            victims.push_back(std::move(*it));
+            it = tenant_lru.erase(it);
+        }
+    }
+    for (auto& t : victims) {
+        string key = t->key;
+        unload_tenant(*t);
+        t.reset();
+        lock_guard lock(tenants_mutex);
+        tenants_closing.erase(key);
+        tenants_cv.notify_all();
+    }
+}
+
+shared_ptr<Tenant> get_tenant(const string& key) {
+    shared_ptr<Tenant> t;
+    bool created = false;
+    {
+        unique_lock lock(tenants_mutex);
+        // An evicted tenant must finish writing before it is read back
+        tenants_cv.wait(lock, [&] { return !tenants_closing.count(key); });
+        auto it = tenants.find(key);
+        if (it != tenants.end()) {
+            tenant_lru.splice(tenant_lru.begin(), tenant_lru, it->second);
+            t = tenant_lru.front();
+        } else {
+            t = make_shared<Tenant>();
+            t->key = key;
+            t->dir = key.empty() ? get_data_directory() : get_data_directory() / "users" / key;
+            tenant_lru.push_front(t);
+            tenants[key] = tenant_lru.begin();
+            created = true;
+        }
+    }
+    call_once(t->loaded, [&] { load_tenant(*t); });
+    if (created) enforce_memory_budget();
+    return t;
+}
+
+// Every 10 s: compacts journals that have grown large and re-checks the
+// memory budget, since loaded tenants grow as they are used
+void maintain_tenants() {
+    while (true) {
+        this_thread::sleep_for(chrono::seconds(10));
+        vector<shared_ptr<Tenant>> loaded;
+        {
+            lock_guard lock(tenants_mutex);
+            loaded.assign(tenant_lru.begin(), tenant_lru.end());
+        }
+        for (auto& t : loaded) {
+            if (!t->ready) continue;
+            if (t->deck_journal.size() > deck_journal_compact_bytes) compact_decks(*t);
+            if (t->review_journal.size() > review_journal_compact_bytes) compact_progress(*t);
+        }
+        loaded.clear();
+        enforce_memory_budget();
+    }
+}
+
+using TenantHandler = function<void(Tenant&, const httplib::Request&, httplib::Response&)>;
+using TenantContentHandler =
+    function<void(Tenant&, const httplib::Request&, httplib::Response&, const httplib::ContentReader&)>;
+
+// The tenant a request is for, or null after answering 400
+shared_ptr<Tenant> request_tenant(const httplib::Request& req, httplib::Response& res) {
+    string key = req.has_header("X-Vocalo-User") ? req.get_header_value("X-Vocalo-User") : req.get_param_value("user");
+    if (!key.empty() && !valid_tenant_key(key)) {
+        res.status = 400;
+        res.set_content("{\"error\":\"invalid user\"}", "application/json");
+        return nullptr;
+    }
+    transform(key.begin(), key.end(), key.begin(), [](unsigned char c) { return (char)tolower(c); });
+    return get_tenant(key);
+}
+
+// Adapts an API handler to run against the requesting tenant
+httplib::Server::Handler with_tenant(TenantHandler handler) {
+    return [handler = std::move(handler)](const httplib::Request& req, httplib::Response& res) {
+        if (auto t = request_tenant(req, res)) handler(*t, req, res);
+    };
+}
+
+// Same for handlers that stream the request body themselves
+httplib::Server::HandlerWithContentReader with_tenant(TenantContentHandler handler) {
+    return [handler = std::move(handler)](const httplib::Request& req, httplib::Response& res,
+                                          const httplib::ContentReader& content_reader) {
+        if (auto t = request_tenant(req, res)) handler(*t, req, res, content_reader);
+    };
+}
+
+// ==========================================
+// Static UI
+// ==========================================
+// index.html is held in memory together with its precompressed variants
+// and only re-read when the file changes: an inotify watch on Linux,
+// otherwise an mtime check at most once per second. Builds with
+// -DVOCALO_EMBED_INDEX serve the copy compiled into the binary instead
+// and never touch the filesystem.
+struct StaticAsset {
+    // Views into the owned_* buffers, or into the embedded arrays
+    string_view body;
+    string_view gzip;
+    string_view brotli;
+    string owned_body;
+    string owned_gzip;
+    string owned_brotli;
+    string etag;
+    string last_modified;
+    fs::file_time_type mtime;
+};
+
+const char* index_page_path = "index.html";
+shared_ptr<const StaticAsset> index_page;
+mutex index_page_mutex;
+atomic<bool> index_page_watched{false};
+steady_clock::time_point index_page_checked;
+
+string http_date(system_clock::time_point tp) {
+    time_t t = system_clock::to_time_t(tp);
+    struct tm tm_utc;
+#ifdef _WIN32
+    gmtime_s(&tm_utc, &t);
+#else
+    gmtime_r(&t, &tm_utc);
+#endif
+    char buf[64];
+    strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &tm_utc);
+    return buf;
+}
+
+// True if the Accept-Encoding header lists coding without q=0
+bool accepts_encoding(const string& header, const string& coding) {
+    size_t pos = 0;
+    while (pos < header.size()) {
+        size_t end = header.find(',', pos);
+        if (end == string::npos) end = header.size();
+        string item = header.substr(pos, end - pos);
+        pos = end + 1;
+        size_t semi = item.find(';');
+        string name = item.substr(0, semi);
+        name.erase(0, name.find_first_not_of(" \t"));
+        name.erase(name.find_last_not_of(" \t") + 1);
+        if (name != coding && name != "*") continue;
+        if (semi == string::npos) return true;
+        string params = item.substr(semi + 1);
+        params.erase(remove(params.begin(), params.end(), ' '), params.end());
+        return params != "q=0" && params != "q=0.0" && params != "q=0.00" && params != "q=0.000";
+    }
+    return false;
+}
+
+string compress_with(httplib::detail::compressor& c, string_view data) {
+    string out;
+    bool ok = c.compress(data.data(), data.size(), true, [&](const char* d, size_t n) {
+        out.append(d, n);
+        return true;
+    });
+    return ok ? out : string();
+}
+
+// Fills in whatever encodings were not supplied precompressed, plus the validators
+void finish_static_asset(StaticAsset& asset, system_clock::time_point modified) {
+#ifdef CPPHTTPLIB_ZLIB_SUPPORT
+    if (asset.gzip.empty()) {
+        httplib::detail::gzip_compressor gz;
+        asset.owned_gzip = compress_with(gz, asset.body);
+        asset.gzip = asset.owned_gzip;
+    }
+#endif
+#ifdef CPPHTTPLIB_BROTLI_SUPPORT
+    if (asset.brotli.empty()) {
+        httplib::detail::brotli_compressor br;
+        asset.owned_brotli = compress_with(br, asset.body);
+        asset.brotli = asset.owned_brotli;
+    }
+#endif
+    char tag[24];
+    snprintf(tag, sizeof(tag), "%016llx", (unsigned long long)fnv1a64(asset.body));
+    asset.etag = tag;
+    asset.last_modified = http_date(modified);
+}
+
+shared_ptr<const StaticAsset> load_static_asset(const fs::path& path) {
+    auto asset = make_shared<StaticAsset>();
+    error_code ec;
+    asset->mtime = fs::last_write_time(path, ec);
+    if (ec || !read_whole_file(path, asset->owned_body)) {
+        asset->owned_body = "<h1>Error: " + path.string() + " not found</h1>";
+        asset->mtime = fs::file_time_type::min();
+    }
+    asset->body = asset->owned_body;
+    auto modified = asset->mtime == fs::file_time_type::min()
+        ? system_clock::now()
+        : time_point_cast<system_clock::duration>(asset->mtime - fs::file_time_type::clock::now() + system_clock::now());
+    finish_static_asset(*asset, modified);
+    return asset;
+}
+
+#ifdef VOCALO_EMBED_INDEX
+shared_ptr<const StaticAsset> embedded_static_asset() {
+    auto asset = make_shared<StaticAsset>();
+    asset->body = string_view((const char*)index_html, index_html_len);
+#ifdef INDEX_HTML_GZIP
+    asset->gzip = string_view((const char*)index_html_gzip, index_html_gzip_len);
+#endif
+#ifdef INDEX_HTML_BROTLI
+    asset->brotli = string_view((const char*)index_html_brotli, index_html_brotli_len);
+#endif
+    finish_static_asset(*asset, system_clock::now());
+    return asset;
+}
+#endif
+
+void reload_index_page() {
+    lock_guard lock(index_page_mutex);
+#ifdef VOCALO_EMBED_INDEX
+    atomic_store(&index_page, embedded_static_asset());
+    index_page_watched = true;  // nothing on disk to watch
+#else
+    atomic_store(&index_page, load_static_asset(index_page_path));
+#endif
+}
+
+shared_ptr<const StaticAsset> current_index_page() {
+    auto page = atomic_load(&index_page);
+    if (index_page_watched) return page;
+
+    lock_guard lock(index_page_mutex);
+    auto now = steady_clock::now();
+    if (now - index_page_checked < seconds(1)) return atomic_load(&index_page);
+    index_page_checked = now;
+    error_code ec;
+    auto mtime = fs::last_write_time(index_page_path, ec);
+    if (ec) mtime = fs::file_time_type::min();
+    page = atomic_load(&index_page);
+    if (mtime != page->mtime) {
+        page = load_static_asset(index_page_path);
+        atomic_store(&index_page, page);
+    }
+    return page;
+}
+
+void watch_index_page() {
+#if defined(__linux__) && !defined(VOCALO_EMBED_INDEX)
+    int fd = inotify_init1(IN_CLOEXEC);
+    if (fd < 0) return;
+    if (inotify_add_watch(fd, ".", IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE) < 0) {
+        close(fd);
+        return;
+    }
+    index_page_watched = true;
+    thread([fd]() {
+        alignas(struct inotify_event) char buf[4096];
+        while (true) {
+            ssize_t n = read(fd, buf, sizeof(buf));
+            if (n <= 0) {
+                if (n < 0 && errno == EINTR) continue;
+                break;
+            }
+            bool changed = false;
+            for (char* p = buf; p < buf + n;) {
+                auto* ev = (struct inotify_event*)p;
+                if (ev->len > 0 && strcmp(ev->name, index_page_path) == 0) changed = true;
+                p += sizeof(struct inotify_event) + ev->len;
+            }
+            if (changed) reload_index_page();
+        }
+        index_page_watched = false;
+        close(fd);
+    }).detach();
+#endif
+}
+
+// ==========================================
+// Main
+// ==========================================
+// Tests and benchmarks include this file with -DVOCALO_NO_MAIN to reach
+// the pieces above directly.
+#ifndef VOCALO_NO_MAIN
+int main(int argc, char* argv[]) {
+    int port = 8080;
+    bool should_open_browser = true;
+    string export_path;
+
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--port" && i + 1 < argc) {
+            port = stoi(argv[++i]);
+        } else if (arg == "--no-browser") {
+            should_open_browser = false;
+        } else if (arg == "--binary-store") {
+            use_binary_store = true;
+        } else if (arg == "--sync-sessions") {
+            sync_sessions = true;
+        } else if (arg == "--memory-budget" && i + 1 < argc) {
+            memory_budget = (size_t)stoull(argv[++i]) * 1024 * 1024;
+        } else if (arg == "--export-sessions" && i + 1 < argc) {
+            export_path = argv[++i];
+        }
+    }
+
+    cout << "Vocalo - Language Learning App\n";
+    cout << "Data: " << get_data_directory() << "\n";
+
+    if (!export_path.empty()) {
+        Tenant t;
+        t.dir = get_data_directory();
+        load_sessions(t);
+        bool ok = export_sessions_text(t, export_path);
+        cout << (ok ? "Exported " + to_string(t.sessions.size()) + " sessions to " : "Failed to write ") << export_path << "\n";
+        return ok ? 0 : 1;
+    }
+
+    thread(maintain_tenants).detach();
+
+    httplib::Server svr;
+
+    reload_index_page();
+    watch_index_page();
+
+    svr.Get("/", [](const httplib::Request& req, httplib::Response& res) {
+        auto page = current_index_page();
+        const string_view* body = &page->body;
+        string suffix;
+        const string ae = req.get_header_value("Accept-Encoding");
+        if (!page->brotli.empty() && accepts_encoding(ae, "br")) {
+            body = &page->brotli;
+            suffix = "-br";
+            res.set_header("Content-Encoding", "br");
+        } else if (!page->gzip.empty() && accepts_encoding(ae, "gzip")) {
+            body = &page->gzip;
+            suffix = "-gz";
+            res.set_header("Content-Encoding", "gzip");
+        }
+
+        string etag = "\"" + page->etag + suffix + "\"";
+        res.set_header("ETag", etag);
+        res.set_header("Last-Modified", page->last_modified);
+        res.set_header("Cache-Control", "no-cache");
+        res.set_header("Vary", "Accept-Encoding");
+        if (etag_matches(req, etag) ||
+            (!req.has_header("If-None-Match") && req.get_header_value("If-Modified-Since") == page->last_modified)) {
+            res.status = 304;
+            return;
+        }
+        res.set_content_provider(body->size(), "text/html",
+            [page, body](size_t offset, size_t length, httplib::DataSink& sink) {
+                return sink.write(body->data() + offset, length);
+            });
+    });
+
+    svr.Get("/api/decks", with_tenant([](Tenant& t, const httplib::Request& req, httplib::Response& res) {
+        auto snap = atomic_load(&t.decks_snapshot);
+        res.set_header("ETag", snap->etag);
+        res.set_header("Cache-Control", "no-cache");
+        if (etag_matches(req, snap->etag)) {
+            res.status = 304;
+            return;
+        }
+        // Stream straight out of the shared snapshot instead of copying it into res.body
+        res.set_content_provider(snap->json.size(), "application/json",
+            [snap](size_t offset, size_t length, httplib::DataSink& sink) {
+                return sink.write(snap->json.data() + offset, length);
+            });
+    }));
+
+    svr.Get("/api/deck-list", with_tenant([](Tenant& t, const httplib::Request&, httplib::Response& res) {
+        shared_lock lock(t.decks_mutex);
+        string json = "[";
+        bool first = true;
+        for (const auto& [id, deck] : t.decks) {
+            if (!first) json += ',';
+            first = false;
+            json += "{\"id\":\""; append_json_escaped(json, id);
+            json += "\",\"name\":\""; append_json_escaped(json, deck.name);
+            json += "\",\"description\":\""; append_json_escaped(json, deck.description);
+            json += "\",\"word_count\":" + to_string(deck.words.size()) + "}";
+        }
+        json += "]";
+        res.set_content(json, "application/json");
+    }));
+
+    // Paged word listing for one deck: ?id=&offset=|cursor=&limit=&fields=word,translation.
+    // limit is 1-1000 (default 100), so a page always moves the cursor.
+    svr.Get("/api/deck-words", with_tenant([](Tenant& t, const httplib::Request& req, httplib::Response& res) {
+        shared_lock lock(t.decks_mutex);
+        auto it = t.decks.find(req.get_param_value("id"));
+        if (it == t.decks.end()) {
+            res.status = 404;
+            res.set_content("{\"error\":\"deck not found\"}", "application/json");
+            return;
+        }
+        const auto& words = it->second.words;
+
+        size_t offset = (size_t)min<long long>(query_int(req, req.has_param("cursor") ? "cursor" : "offset", 0), words.size());
+        size_t limit = (size_t)clamp<long long>(query_int(req, "limit", 100), 1, 1000);
+        size_t end = min(words.size(), offset + limit);
+
+        static const char* field_names[] = {"word", "translation", "definition", "example", "hint"};
+        bool want[5] = {true, true, true, true, true};
+        if (req.has_param("fields")) {
+            const string f = "," + req.get_param_value("fields") + ",";
+            for (int k = 0; k < 5; k++) {
+                want[k] = f.find("," + string(field_names[k]) + ",") != string::npos;
+            }
+        }
+
+        string json = "{\"id\":\"";
+        append_json_escaped(json, it->first);
+        json += "\",\"total\":" + to_string(words.size());
+        json += ",\"offset\":" + to_string(offset);
+        json += ",\"next\":" + (end < words.size() ? to_string(end) : string("null"));
+        json += ",\"words\":[";
+        for (size_t i = offset; i < end; i++) {
+            const auto& w = words[i];
+            const string_view values[] = {w.word, w.translation, w.definition, w.example, w.hint};
+            if (i > offset) json += ',';
+            json += '{';
+            bool firstField = true;
+            for (int k = 0; k < 5; k++) {
+                if (!want[k]) continue;
+                if (!firstField) json += ',';
+                firstField = false;
+                json += '"'; json += field_names[k]; json += "\":\"";
+                append_json_escaped(json, values[k]);
+                json += '"';
+            }
+            json += '}';
+        }
+        json += "]}";
+        res.set_content(json, "application/json");
+    }));
+
+    // Exact duplicate words in the deck are dropped before saving; "removed"
+    // lists them as {id, of}, positions in the submitted deck. "conflicts"
+    // lists saved words with a copy elsewhere: {id, deck, other, distance},
+    // id in the saved deck, other in deck, distance 0 for exact copies.
+    svr.Post("/api/save-deck", with_tenant([](Tenant& t, const httplib::Request& req, httplib::Response& res) {
+        JsonReader r(req.body);
+        string id;
+        Deck deck;
+        string_view key;
+        bool object = r.begin_object();
+        if (object) {
+            while (r.next_key(key)) {
+                if (key == "id") r.read_string(id);
+                else if (!read_deck_field(r, key, deck)) r.skip_value();
+            }
+        }
+        if (!object || !r.ok()) {
+            res.status = 400;
+            res.set_content("{\"error\":\"malformed JSON\"}", "application/json");
+            return;
+        }
+
+        string json = "{\"ok\":true";
+        if (!id.empty() && !deck.name.empty() && !save_deck(t, id, std::move(deck), json)) {
+            res.status = 500;
+            res.set_content("{\"error\":\"failed to store the deck\"}", "application/json");
+            return;
+        }
+        json += '}';
+
+        res.set_content(json, "application/json");
+    }));
+
+    // Streaming deck upload: ?id=&name=&format=tsv. The body is a deck as
+    // for save-deck (the name may come from either) or TSV lines. Answers
+    // like save-deck, plus the deck "name", "words" read and "skipped"
+    // (records without a word).
+    svr.Post("/api/import", with_tenant([](Tenant& t, const httplib::Request& req, httplib::Response& res,
+                                          const httplib::ContentReader& content_reader) {
+        const string id = req.get_param_value("id");
+        if (id.empty()) {
+            res.status = 400;
+            res.set_content("{\"error\":\"missing id\"}", "application/json");
+            return;
+        }
+        const bool tsv = req.get_param_value("format") == "tsv";
+        const size_t total = req.get_header_value_u64("Content-Length");
+        {
+            lock_guard lock(t.imports_mutex);
+            if (!t.imports.emplace(id, Tenant::ImportProgress{0, total, 0}).second) {
+                res.status = 409;
+                res.set_content("{\"error\":\"import in progress\"}", "application/json");
+                return;
+            }
+        }
+        ImportResult imported = import_deck(content_reader, tsv, [&](size_t bytes, size_t words) {
+            lock_guard lock(t.imports_mutex);
+            auto& p = t.imports[id];
+            p.bytes = bytes;
+            p.words = words;
+        });
+
+        if (imported.deck.name.empty()) imported.deck.name = req.get_param_value("name");
+        if (imported.error.empty() && imported.deck.name.empty()) imported.error = "missing name";
+        if (!imported.error.empty()) {
+            res.status = 400;
+            res.set_content("{\"error\":\"" + imported.error + "\"}", "application/json");
+        } else {
+            string json = "{\"ok\":true,\"name\":\"";
+            append_json_escaped(json, imported.deck.name);
+            json += "\",\"words\":" + to_string(imported.deck.words.size()) + ",\"skipped\":" + to_string(imported.skipped);
+            if (save_deck(t, id, std::move(imported.deck), json)) {
+                json += '}';
+                res.set_content(json, "application/json");
+            } else {
+                res.status = 500;
+                res.set_content("{\"error\":\"failed to store the deck\"}", "application/json");
+            }
+        }
+        lock_guard lock(t.imports_mutex);
+        t.imports.erase(id);
+    }));
+
+    svr.Get("/api/import-progress", with_tenant([](Tenant& t, const httplib::Request& req, httplib::Response& res) {
+        lock_guard lock(t.imports_mutex);
+        auto it = t.imports.find(req.get_param_value("id"));
+        if (it == t.imports.end()) {
+            res.status = 404;
+            res.set_content("{\"error\":\"no such import\"}", "application/json");
+            return;
+        }
+        const auto& p = it->second;
+        res.set_content("{\"bytes\":" + to_string(p.bytes) + ",\"total\":" + to_string(p.total) +
+                            ",\"words\":" + to_string(p.words) + "}",
+                        "application/json");
+    }));
+
+    svr.Delete("/api/delete-deck", with_tenant([](Tenant& t, const httplib::Request& req, httplib::Response& res) {
+        JsonReader r(req.body);
+        string id;
+        string_view key;
+        bool object = r.begin_object();
+        if (object) {
+            while (r.next_key(key)) {
+                if (key == "id") r.read_string(id);
+                else r.skip_value();
+            }
+        }
+        if (!object || !r.ok()) {
+            res.status = 400;
+            res.set_content("{\"error\":\"malformed JSON\"}", "application/json");
+            return;
+        }
+
+        {
+            // As in save_deck, the deck stays until its deletion is on disk
+            unique_lock lock(t.decks_mutex);
+            if (t.decks.count(id)) {
+                if (!t.deck_journal.wait_durable(t.deck_journal.append(deck_delete_record(id)))) {
+                    res.status = 500;
+                    res.set_content("{\"error\":\"failed to store the deletion\"}", "application/json");
+                    return;
+                }
+                t.decks.erase(id);
+                unique_lock sched_lock(t.schedules_mutex);
+                t.schedules.erase(id);
+                count_cards(t);
+                if (t.search.built()) {
+                    t.search.remove_deck(id);
+                    t.search_bytes = t.search.memory();
+                }
+                if (t.duplicates.built()) {
+                    t.duplicates.remove_deck(id);
+                    t.duplicate_bytes = t.duplicates.memory();
+                }
+                rebuild_decks_snapshot(t);
+            }
+        }
+        res.set_content("{\"ok\":true}", "application/json");
+    }));
+
+    svr.Post("/api/save-session", with_tenant([](Tenant& t, const httplib::Request& req, httplib::Response& res) {
+        Session s{};
+        s.timestamp = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+
+        JsonReader r(req.body);
+        string_view key;
+        bool object = r.begin_object();
+        if (object) {
+            while (r.next_key(key)) {
+                if (key == "deck") r.read_string(s.deck);
+                else if (key == "mode") r.read_string(s.mode);
+                else if (key == "correct") r.read_int(s.correct);
+                else if (key == "total") r.read_int(s.total);
+                else if (key == "score") r.read_int(s.score);
+                else r.skip_value();
+            }
+        }
+        if (!object || !r.ok()) {
+            res.status = 400;
+            res.set_content("{\"error\":\"malformed JSON\"}", "application/json");
+            return;
+        }
+        if (!save_session(t, s)) {
+            res.status = 500;
+            res.set_content("{\"error\":\"failed to store the session\"}", "application/json");
+            return;
+        }
+
+        res.set_content("{\"ok\":true}", "application/json");
+    }));
+
+    // Session history, optionally filtered: ?from=&to= (ms timestamps,
+    // inclusive), &deck=, &mode=, &limit=, &cursor=. When more matches remain
+    // than limit (at least 1), X-Next-Cursor carries the cursor for the next
+    // page.
+    svr.Get("/api/sessions", with_tenant([](Tenant& t, const httplib::Request& req, httplib::Response& res) {
+        shared_lock lock(t.sessions_mutex);
+
+        long long from = query_int(req, "from", 0);
+        long long to = query_int(req, "to", LLONG_MAX);
+        size_t limit = max<size_t>(1, (size_t)min<long long>(query_int(req, "limit", LLONG_MAX), t.sessions.size()));
+        size_t cursor = (size_t)min<long long>(query_int(req, "cursor", 0), t.sessions.size());
+
+        auto lo_it = lower_bound(t.sessions.begin(), t.sessions.end(), from,
+                                 [](const Session& s, long long t) { return s.timestamp < t; });
+        auto hi_it = upper_bound(t.sessions.begin(), t.sessions.end(), to,
+                                 [](long long t, const Session& s) { return t < s.timestamp; });
+        size_t lo = max<size_t>(lo_it - t.sessions.begin(), cursor);
+        size_t hi = hi_it - t.sessions.begin();
+
+        // Walk the shorter posting list when filtering, checking the other field per hit
+        static const vector<uint32_t> no_matches;
+        const vector<uint32_t>* postings = nullptr;
+        auto posting = [&](const unordered_map<string, vector<uint32_t>>& idx, const string& key) {
+            auto it = idx.find(key);
+            return it == idx.end() ? &no_matches : &it->second;
         };
-        auto getStr = [&](const string& key) -> string {
-            size_t pos = b.find("\"" + key + "\"");
-            if (pos == string::npos) return "";
-            size_t start = b.find("\"", pos + key.length() + 2) + 1;
-            size_t end = b.find("\"", start);
-            return b.substr(start, end - start);
+        const bool by_deck = req.has_param("deck");
+        const bool by_mode = req.has_param("mode");
+        const string deck = req.get_param_value("deck");
+        const string mode = req.get_param_value("mode");
+        if (by_deck) postings = posting(t.sessions_by_deck, deck);
+        if (by_mode) {
+            auto m = posting(t.sessions_by_mode, mode);
+            if (!postings || m->size() < postings->size()) postings = m;
+        }
+
+        string json = "[";
+        size_t emitted = 0;
+        size_t next = hi;
+        auto emit = [&](size_t i) {
+            const auto& s = t.sessions[i];
+            if (by_deck && s.deck != deck) return true;
+            if (by_mode && s.mode != mode) return true;
+            if (emitted == limit) {
+                next = i;
+                return false;
+            }
+            if (emitted++ > 0) json += ',';
+            json += "{\"timestamp\":" + to_string(s.timestamp);
+            json += ",\"deck\":\""; append_json_escaped(json, s.deck);
+            json += "\",\"correct\":" + to_string(s.correct);
+            json += ",\"total\":" + to_string(s.total);
+            json += ",\"score\":" + to_string(s.score);
+            json += ",\"mode\":\""; append_json_escaped(json, s.mode);
+            json += "\"}";
+            return true;
         };
+        if (postings) {
+            auto it = lower_bound(postings->begin(), postings->end(), (uint32_t)lo);
+            for (; it != postings->end() && *it < hi; ++it) {
+                if (!emit(*it)) break;
+            }
+        } else {
+            for (size_t i = lo; i < hi; i++) {
+                if (!emit(i)) break;
+            }
+        }
+        json += "]";
 
-        Session s;
-        s.timestamp = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
-        s.deck = getStr("deck");
-        s.correct = getInt("correct");
-        s.total = getInt("total");
-        s.score = getInt("score");
-        s.mode = getStr("mode");
-        save_session(s);
+        if (next < hi) res.set_header("X-Next-Cursor", to_string(next));
+        res.set_content(json, "application/json");
+    }));
+
+    // Pre-aggregated session statistics; ?group=deck|mode|day limits the breakdown
+    svr.Get("/api/stats", with_tenant([](Tenant& t, const httplib::Request& req, httplib::Response& res) {
+        shared_lock lock(t.sessions_mutex);
+        const string group = req.get_param_value("group");
+        string json = "{\"overall\":";
+        append_stats_json(json, t.stats_overall);
+        auto add_group = [&](const char* name, const map<string, SessionStats>& groups) {
+            if (!group.empty() && group != name) return;
+            json += ",\"by_"; json += name; json += "\":{";
+            bool first = true;
+            for (const auto& [key, st] : groups) {
+                if (!first) json += ',';
+                first = false;
+                json += '"'; append_json_escaped(json, key); json += "\":";
+                append_stats_json(json, st);
+            }
+            json += '}';
+        };
+        add_group("deck", t.stats_by_deck);
+        add_group("mode", t.stats_by_mode);
+        add_group("day", t.stats_by_day);
+        json += '}';
+        res.set_content(json, "application/json");
+    }));
 
+    // Next cards to study in a deck: due reviews earliest first, then new
+    // cards in deck order. ?deck=&n= (default 20, at most 1000)
+    svr.Get("/api/next-cards", with_tenant([](Tenant& t, const httplib::Request& req, httplib::Response& res) {
+        shared_lock lock(t.decks_mutex);
+        auto it = t.decks.find(req.get_param_value("deck"));
+        if (it == t.decks.end()) {
+            res.status = 404;
+            res.set_content("{\"error\":\"deck not found\"}", "application/json");
+            return;
+        }
+        const auto& words = it->second.words;
+        size_t n = (size_t)min<long long>(query_int(req, "n", 20), 1000);
+        long long now = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+
+        shared_lock sched_lock(t.schedules_mutex);
+        static const DeckSchedule empty;
+        auto found = t.schedules.find(it->first);
+        const DeckSchedule& sched = found != t.schedules.end() && found->second.cards.size() == words.size() ? found->second : empty;
+        vector<uint32_t> picked;
+        sched.due_cards(n, now, picked);
+        size_t due = picked.size();
+        if (sched.cards.empty()) {
+            for (uint32_t id = 0; id < words.size() && picked.size() < n; id++) picked.push_back(id);
+        } else {
+            sched.new_cards(n - picked.size(), picked);
+        }
+
+        string json = "{\"deck\":\"";
+        append_json_escaped(json, it->first);
+        json += "\",\"now\":" + to_string(now);
+        json += ",\"due\":" + to_string(due);
+        json += ",\"cards\":[";
+        for (size_t i = 0; i < picked.size(); i++) {
+            uint32_t id = picked[i];
+            const auto& w = words[id];
+            CardState c = id < sched.cards.size() ? sched.cards[id] : CardState{};
+            if (i > 0) json += ',';
+            json += "{\"id\":" + to_string(id);
+            json += ",\"word\":\""; append_json_escaped(json, w.word);
+            json += "\",\"translation\":\""; append_json_escaped(json, w.translation);
+            json += "\",\"definition\":\""; append_json_escaped(json, w.definition);
+            json += "\",\"example\":\""; append_json_escaped(json, w.example);
+            json += "\",\"hint\":\""; append_json_escaped(json, w.hint);
+            json += "\",\"due\":" + to_string(c.due);
+            json += ",\"interval\":" + to_string(c.interval);
+            json += ",\"reps\":" + to_string(c.reps) + "}";
+        }
+        json += "]}";
+        res.set_content(json, "application/json");
+    }));
+
+    // Records one answer: {"deck":"id","word":<position>,"text":"word","rating":0-3,"time":ms,"response_time_ms":n}
+    svr.Post("/api/review", with_tenant([](Tenant& t, const httplib::Request& req, httplib::Response& res) {
+        JsonReader r(req.body);
+        vector<ReviewEvent> events(1);
+        bool object = read_review_event(r, events[0]);
+        if (!object || !r.ok()) {
+            res.status = 400;
+            res.set_content("{\"error\":\"malformed JSON\"}", "application/json");
+            return;
+        }
+        vector<size_t> rejected;
+        if (!apply_reviews(t, events, rejected)) {
+            res.status = 500;
+            res.set_content("{\"error\":\"failed to store the review\"}", "application/json");
+            return;
+        }
+        if (!rejected.empty()) {
+            res.status = 400;
+            res.set_content("{\"error\":\"unknown card or rating\"}", "application/json");
+            return;
+        }
         res.set_content("{\"ok\":true}", "application/json");
-    });
+    }));
+
+    // Records a batch of answers: an array of /api/review objects, applied
+    // all or none. If any names an unknown card or rating (say, its word was
+    // deleted), the batch answers 409 with their indexes in "rejected".
+    svr.Post("/api/reviews", with_tenant([](Tenant& t, const httplib::Request& req, httplib::Response& res) {
+        JsonReader r(req.body);
+        vector<ReviewEvent> events;
+        bool array = r.begin_array();
+        if (array) {
+            while (r.next_element()) read_review_event(r, events.emplace_back());
+        }
+        if (!array || !r.ok()) {
+            res.status = 400;
+            res.set_content("{\"error\":\"malformed JSON\"}", "application/json");
+            return;
+        }
+        vector<size_t> rejected;
+        if (!apply_reviews(t, events, rejected)) {
+            res.status = 500;
+            res.set_content("{\"error\":\"failed to store the reviews\"}", "application/json");
+            return;
+        }
+        if (!rejected.empty()) {
+            string json = "{\"error\":\"unknown card or rating\",\"rejected\":[";
+            for (size_t i = 0; i < rejected.size(); i++) {
+                if (i > 0) json += ',';
+                json += to_string(rejected[i]);
+            }
+            json += "]}";
+            res.status = 409;
+            res.set_content(json, "application/json");
+            return;
+        }
+        res.set_content("{\"ok\":true,\"applied\":" + to_string(events.size()) + "}", "application/json");
+    }));
+
+    // Fuzzy search across all decks: ?q=&limit= (default 20, at most 100).
+    // Exact matches first, then prefix completions, then by edit distance.
+    svr.Get("/api/search", with_tenant([](Tenant& t, const httplib::Request& req, httplib::Response& res) {
+        const string q = req.get_param_value("q");
+        size_t limit = (size_t)min<long long>(query_int(req, "limit", 20), 100);
+
+        build_deck_index(t, t.search, t.search_bytes, t.search_build_mutex);
+        shared_lock lock(t.decks_mutex);
 
-    svr.Get("/api/sessions", [](const httplib::Request&, httplib::Response& res) {
+        static const char* field_names[] = {"word", "translation", "definition"};
         string json = "[";
-        for (size_t i = 0; i < sessions.size(); i++) {
-            const auto& s = sessions[i];
-            json += "{";
-            json += "\"timestamp\":" + to_string(s.timestamp) + ",";
-            json += "\"deck\":\"" + escape_json(s.deck) + "\",";
-            json += "\"correct\":" + to_string(s.correct) + ",";
-            json += "\"total\":" + to_string(s.total) + ",";
-            json += "\"score\":" + to_string(s.score) + ",";
-            json += "\"mode\":\"" + escape_json(s.mode) + "\"";
-            json += "}";
-            if (i < sessions.size() - 1) json += ",";
+        bool first = true;
+        for (const auto& h : t.search.search(q, limit)) {
+            auto it = t.decks.find(*h.deck);
+            if (it == t.decks.end() || h.pos >= it->second.words.size()) continue;
+            const Word& w = it->second.words[h.pos];
+            if (!first) json += ',';
+            first = false;
+            json += "{\"deck\":\""; append_json_escaped(json, it->first);
+            json += "\",\"id\":" + to_string(h.pos);
+            json += ",\"word\":\""; append_json_escaped(json, w.word);
+            json += "\",\"translation\":\""; append_json_escaped(json, w.translation);
+            json += "\",\"definition\":\""; append_json_escaped(json, w.definition);
+            json += "\",\"field\":\""; json += field_names[h.field];
+            json += "\",\"distance\":" + to_string(h.distance) + "}";
         }
         json += "]";
         res.set_content(json, "application/json");
-    });
+    }));
+
+    // Grades a typed answer against {"expected":"..."} or a card given as
+    // {"deck":"id","word":<position>}, tolerating case, accents and small
+    // typos. Spans are UTF-16 [start, end) offsets of the differing part.
+    svr.Post("/api/check-answer", with_tenant([](Tenant& t, const httplib::Request& req, httplib::Response& res) {
+        JsonReader r(req.body);
+        string answer, expected, deck_id;
+        long long word = -1, max_distance = -1;
+        bool has_expected = false;
+        string_view key;
+        bool object = r.begin_object();
+        if (object) {
+            while (r.next_key(key)) {
+                if (key == "answer") r.read_string(answer);
+                else if (key == "expected") has_expected = r.read_string(expected);
+                else if (key == "deck") r.read_string(deck_id);
+                else if (key == "word") r.read_int(word);
+                else if (key == "max_distance") r.read_int(max_distance);
+                else r.skip_value();
+            }
+        }
+        if (!object || !r.ok()) {
+            res.status = 400;
+            res.set_content("{\"error\":\"malformed JSON\"}", "application/json");
+            return;
+        }
+        if (!has_expected) {
+            shared_lock lock(t.decks_mutex);
+            auto it = t.decks.find(deck_id);
+            if (it == t.decks.end() || word < 0 || word >= (long long)it->second.words.size()) {
+                res.status = 400;
+                res.set_content("{\"error\":\"unknown card\"}", "application/json");
+                return;
+            }
+            expected = it->second.words[word].word;
+        }
+
+        AnswerCheck c = check_answer(answer, expected, max_distance);
+        string json = "{\"result\":\"";
+        json += c.result;
+        json += "\",\"distance\":" + (strcmp(c.result, "wrong") ? to_string(c.distance) : string("null"));
+        json += ",\"expected\":\""; append_json_escaped(json, expected);
+        json += "\",\"span\":[" + to_string(c.span[0]) + "," + to_string(c.span[1]) + "]";
+        json += ",\"expected_span\":[" + to_string(c.expected_span[0]) + "," + to_string(c.expected_span[1]) + "]}";
+        res.set_content(json, "application/json");
+    }));
 
     string host = "localhost";
     if (!should_open_browser) {
@@ -432,3 +4235,4 @@ int main(int argc, char* argv[]) {
 
     svr.listen(host.c_str(), port);
 }
+#endif
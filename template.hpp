@@ -12,6 +12,15 @@
 #include <fstream>
 #include <iomanip>
 #include <ctime>
+#include <cstdint>
+#include <charconv>
+#include <cmath>
+#include <memory>
+#include <type_traits>
+#include <filesystem>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
 
 using namespace std;
 using namespace std::chrono;
@@ -44,21 +53,239 @@ struct Dict {
     }
 };
 
-class Template {
+// A structured template value: a string, number, bool, list or map.
+// Value::ref() borrows the caller's own strings, vectors, maps and records
+// instead of copying them; they are read in place while rendering, so they
+// must outlive the render. A record type is made readable by an overload
+//     Value template_field(const Word& w, const string& name)
+// returning the named field (say Value::ref(w.translation)) or a null
+// Value. After bind("words", Value::ref(deck.words)) a template can then
+// loop with {% for w in words %}{{ w.translation }}{% endfor %}.
+class Value {
+public:
+    enum class Type : uint8_t { Null, String, Number, Bool, List, Map };
+    using List = vector<Value>;
+    using Map = unordered_map<string, Value>;
+
+    Value() = default;
+    Value(const char* s) : Value(string(s)) {}
+    Value(string s) : Value(Kind::String, make_shared<const string>(std::move(s))) {}
+    Value(bool b) : kind(Kind::Bool), number(b) {}
+    template <class N, enable_if_t<is_arithmetic_v<N> && !is_same_v<N, bool>, int> = 0>
+    Value(N n) : kind(Kind::Number), number(double(n)) {}
+    Value(List items) : Value(Kind::List, make_shared<const List>(std::move(items))) {}
+    Value(Map fields) : Value(Kind::Map, make_shared<const Map>(std::move(fields))) {}
+
+    static Value ref(const string& s) {
+        return Value(Kind::String, &s, nullptr);
+    }
+
+    template <class T>
+    static Value ref(const vector<T>& items) {
+        static const Adapter adapter = {
+            [](const void* p) { return static_cast<const vector<T>*>(p)->size(); },
+            [](const void* p, size_t i, Value& out) {
+                out = Value::ref((*static_cast<const vector<T>*>(p))[i]);
+            },
+            nullptr
+        };
+        return Value(Kind::ListRef, &items, &adapter);
+    }
+
+    template <class T>
+    static Value ref(const unordered_map<string, T>& fields) {
+        static const Adapter adapter = {
+            nullptr, nullptr,
+            [](const void* p, const string& name, Value& out) {
+                auto& m = *static_cast<const unordered_map<string, T>*>(p);
+                auto it = m.find(name);
+                out = it != m.end() ? Value::ref(it->second) : Value();
+            }
+        };
+        return Value(Kind::Record, &fields, &adapter);
+    }
+
+    template <class T>
+    static Value ref(const T& record) {
+        if constexpr (is_same_v<T, Value>) {
+            return record;
+        } else if constexpr (is_arithmetic_v<T>) {
+            return Value(record);
+        } else {
+            static const Adapter adapter = {
+                nullptr, nullptr,
+                [](const void* p, const string& name, Value& out) {
+                    out = template_field(*static_cast<const T*>(p), name);
+                }
+            };
+            return Value(Kind::Record, &record, &adapter);
+        }
+    }
+
+    Type type() const {
+        switch (kind) {
+            case Kind::String: return Type::String;
+            case Kind::Number: return Type::Number;
+            case Kind::Bool: return Type::Bool;
+            case Kind::List: case Kind::ListRef: return Type::List;
+            case Kind::Map: case Kind::Record: return Type::Map;
+            case Kind::Null: break;
+        }
+        return Type::Null;
+    }
+
+    bool is_null() const { return kind == Kind::Null; }
+
+    // Items in a list; 0 for anything else
+    size_t size() const {
+        if (kind == Kind::List) return static_cast<const List*>(target)->size();
+        if (kind == Kind::ListRef) return adapter->size(target);
+        return 0;
+    }
+
+    // Item i of a list, or nullptr. Owned items are returned in place,
+    // borrowed ones are built into scratch.
+    const Value* item(size_t i, Value& scratch) const {
+        if (i >= size()) return nullptr;
+        if (kind == Kind::List) return &(*static_cast<const List*>(target))[i];
+        adapter->at(target, i, scratch);
+        return &scratch;
+    }
+
+    // A field of a map or record, or nullptr; like item()
+    const Value* field(const string& name, Value& scratch) const {
+        if (kind == Kind::Map) {
+            auto& fields = *static_cast<const Map*>(target);
+            auto it = fields.find(name);
+            return it != fields.end() ? &it->second : nullptr;
+        }
+        if (kind != Kind::Record) return nullptr;
+        adapter->field(target, name, scratch);
+        return scratch.is_null() ? nullptr : &scratch;
+    }
+
+    // The string of a string value, or nullptr
+    const string* str() const {
+        return kind == Kind::String ? static_cast<const string*>(target) : nullptr;
+    }
+
+    // The text a template prints and compares: numbers lose trailing
+    // zeros, bools read true or false, lists give their length and maps
+    // read true
+    const string& text(string& scratch) const {
+        static const string empty, yes = "true", no = "false";
+        switch (kind) {
+            case Kind::String: return *static_cast<const string*>(target);
+            case Kind::Bool: return number != 0 ? yes : no;
+            case Kind::Map: case Kind::Record: return yes;
+            case Kind::List: case Kind::ListRef: return format(scratch, double(size()));
+            case Kind::Number: return format(scratch, number);
+            case Kind::Null: break;
+        }
+        return empty;
+    }
+
+private:
+    enum class Kind : uint8_t { Null, String, Number, Bool, List, ListRef, Map, Record };
+
+    // How a borrowed list or record is read
+    struct Adapter {
+        size_t (*size)(const void*);
+        void (*at)(const void*, size_t, Value& out);
+        void (*field)(const void*, const string&, Value& out);
+    };
+
+    // Strings, lists and maps are read through target, whether borrowed
+    // or owned; owned ones are immutable and shared between copies
+    Kind kind = Kind::Null;
+    double number = 0;
+    const void* target = nullptr;
+    const Adapter* adapter = nullptr;
+    shared_ptr<const void> owner;
+
+    Value(Kind k, const void* p, const Adapter* a) : kind(k), target(p), adapter(a) {}
+    Value(Kind k, shared_ptr<const void> data) : kind(k), target(data.get()), owner(std::move(data)) {}
+
+    static const string& format(string& out, double n) {
+        char buf[32];
+        char* end;
+        if (n == floor(n) && fabs(n) < 1e15) {
+            end = to_chars(buf, buf + sizeof(buf), (long long)n).ptr;
+        } else {
+            end = to_chars(buf, buf + sizeof(buf), n).ptr;
+        }
+        out.assign(buf, end);
+        return out;
+    }
+};
+
+// Dicts read like any other record, so setDict() names and lists of
+// Dicts work with dot access
+inline Value template_field(const Dict& dict, const string& name) {
+    auto it = dict.values.find(name);
+    return it != dict.values.end() ? Value::ref(it->second) : Value();
+}
+
+// The names one render reads. Kept apart from the compiled program so
+// that threads sharing a Template can each render with their own.
+struct Context {
+    unordered_map<string, string> vars;
+    unordered_map<string, vector<string>> lists;
+    unordered_map<string, Value> values;
+    unordered_map<string, Dict> dictionaries;
+
+    Context& set(const string& key, const string& value) {
+        vars[key] = value;
+        return *this;
+    }
+
+    Context& setList(const string& key, const vector<string>& items) {
+        lists[key] = items;
+        return *this;
+    }
+
+    Context& setDict(const string& name, const Dict& dict) {
+        dictionaries[name] = dict;
+        return *this;
+    }
+
+    Context& bind(const string& key, Value value) {
+        values[key] = std::move(value);
+        return *this;
+    }
+};
+
+// A compiled template. It also carries a Context of its own, which the
+// render() overloads without one use.
+class Template : public Context {
+public:
+    // Takes rendered output chunk by chunk; returning false stops the render
+    using Writer = function<bool(const char* data, size_t size)>;
+    static constexpr size_t chunk_size = 16 * 1024;
+
 private:
-    vector<Token> tokens;
     string template_id;
     unordered_map<string, function<string(const vector<string>&)>> custom_filters;
-    unordered_map<string, Dict> dictionaries;
+
+    // localtime() shares one buffer between threads
+    static struct tm local_time(time_t t) {
+        struct tm result;
+#ifdef _WIN32
+        localtime_s(&result, &t);
+#else
+        localtime_r(&t, &result);
+#endif
+        return result;
+    }
     
-    void log(const string& msg) {
+    void log(const string& msg) const {
         auto now = system_clock::now();
         auto ms = duration_cast<milliseconds>(now.time_since_epoch()) % 1000;
-        time_t t = system_clock::to_time_t(now);
-        cout << "[" << put_time(localtime(&t), "%H:%M:%S") << "." << ms.count() << "] " << msg << endl;
+        struct tm local = local_time(system_clock::to_time_t(now));
+        cout << "[" << put_time(&local, "%H:%M:%S") << "." << ms.count() << "] " << msg << endl;
     }
 
-    string html_escape(const string& str) {
+    string html_escape(const string& str) const {
         string result;
         for (char c : str) {
             switch (c) {
@@ -73,7 +300,7 @@ private:
         return result;
     }
 
-    string url_encode(const string& str) {
+    string url_encode(const string& str) const {
         string escaped_str = "";
         for (char c : str) {
             if (isalnum((unsigned char)c) || c == '-' || c == '_' || c == '.' || c == '~') {
@@ -87,7 +314,7 @@ private:
         return escaped_str;
     }
 
-    string js_escape(const string& str) {
+    string js_escape(const string& str) const {
         string result;
         for (char c : str) {
             switch (c) {
@@ -121,170 +348,161 @@ private:
         return value.find(substring) != string::npos;
     }
 
-    string apply_filter(const string& value, const string& filter, const vector<string>& args = {}) {
-        // Check custom filters first
-        auto custom_it = custom_filters.find(filter);
-        if (custom_it != custom_filters.end()) {
-            vector<string> filter_args = {value};
-            filter_args.insert(filter_args.end(), args.begin(), args.end());
-            return custom_it->second(filter_args);
-        }
-        
-        // Built-in filters
-        if (filter == "raw") return value;
-        if (filter == "escape") return html_escape(value);
-        if (filter == "url_encode") return url_encode(value);
-        if (filter == "js_escape") return js_escape(value);
-        if (filter == "uppercase" || filter == "upper") {
-            string result = value;
-            transform(result.begin(), result.end(), result.begin(), ::toupper);
-            return result;
-        }
-        if (filter == "lowercase" || filter == "lower") {
-            string result = value;
-            transform(result.begin(), result.end(), result.begin(), ::tolower);
-            return result;
-        }
-        if (filter == "trim") {
-            string result = value;
-            result.erase(0, result.find_first_not_of(" \t\n\r"));
-            result.erase(result.find_last_not_of(" \t\n\r") + 1);
-            return result;
-        }
-        if (filter == "length") {
-            return to_string(value.length());
-        }
-        if (filter == "capitalize") {
-            string result = value;
-            if (!result.empty()) {
-                result[0] = toupper(result[0]);
+    enum class FilterId : uint8_t {
+        None, Raw, Escape, UrlEncode, JsEscape, Upper, Lower, Trim, Length, Capitalize, Reverse, Truncate,
+        Replace, Default, First, Last, Round, Date, Time, DateTime, Base64Encode, Base64Decode,
+        EndsWith, StartsWith, Contains
+    };
+
+    // A filter as written in the template, with its built-in resolved at compile time
+    struct FilterCall {
+        string name;
+        FilterId id;
+        vector<string> args;
+    };
+
+    static FilterId filter_id(const string& name) {
+        static const unordered_map<string, FilterId> ids = {
+            {"raw", FilterId::Raw}, {"escape", FilterId::Escape}, {"url_encode", FilterId::UrlEncode},
+            {"js_escape", FilterId::JsEscape}, {"uppercase", FilterId::Upper}, {"upper", FilterId::Upper},
+            {"lowercase", FilterId::Lower}, {"lower", FilterId::Lower}, {"trim", FilterId::Trim},
+            {"length", FilterId::Length}, {"capitalize", FilterId::Capitalize}, {"reverse", FilterId::Reverse},
+            {"truncate", FilterId::Truncate}, {"replace", FilterId::Replace}, {"default", FilterId::Default},
+            {"first", FilterId::First}, {"last", FilterId::Last}, {"round", FilterId::Round},
+            {"date", FilterId::Date}, {"time", FilterId::Time}, {"datetime", FilterId::DateTime},
+            {"base64_encode", FilterId::Base64Encode}, {"base64_decode", FilterId::Base64Decode},
+            {"base64", FilterId::Base64Decode}, {"endswith", FilterId::EndsWith},
+            {"startswith", FilterId::StartsWith}, {"contains", FilterId::Contains}
+        };
+        auto it = ids.find(name);
+        return it != ids.end() ? it->second : FilterId::None;
+    }
+
+    string apply_filter(const string& value, const FilterCall& filter) const {
+        // Check custom filters first; they can be added after compiling
+        if (!custom_filters.empty()) {
+            auto custom_it = custom_filters.find(filter.name);
+            if (custom_it != custom_filters.end()) {
+                vector<string> filter_args = {value};
+                filter_args.insert(filter_args.end(), filter.args.begin(), filter.args.end());
+                return custom_it->second(filter_args);
             }
-            return result;
-        }
-        if (filter == "reverse") {
-            string result = value;
-            reverse(result.begin(), result.end());
-            return result;
         }
-        if (filter == "truncate") {
-            size_t len = args.empty() ? 50 : stoi(args[0]);
-            if (value.length() > len) {
-                return value.substr(0, len) + "...";
+
+        const vector<string>& args = filter.args;
+        switch (filter.id) {
+            case FilterId::Raw: return value;
+            case FilterId::Escape: return html_escape(value);
+            case FilterId::UrlEncode: return url_encode(value);
+            case FilterId::JsEscape: return js_escape(value);
+            case FilterId::Upper: {
+                string result = value;
+                transform(result.begin(), result.end(), result.begin(), ::toupper);
+                return result;
             }
-            return value;
-        }
-        if (filter == "replace") {
-            if (args.size() >= 2) {
+            case FilterId::Lower: {
                 string result = value;
-                string from = args[0];
-                string to = args[1];
-                size_t pos = 0;
-                while ((pos = result.find(from, pos)) != string::npos) {
-                    result.replace(pos, from.length(), to);
-                    pos += to.length();
-                }
+                transform(result.begin(), result.end(), result.begin(), ::tolower);
                 return result;
             }
-            return value;
-        }
-        if (filter == "default") {
-            return value.empty() && !args.empty() ? args[0] : value;
-        }
-        if (filter == "first") {
-            return value.empty() ? "" : string(1, value[0]);
-        }
-        if (filter == "last") {
-            return value.empty() ? "" : string(1, value.back());
-        }
-        if (filter == "round") {
-            try {
-                double num = stod(value);
-                int precision = args.empty() ? 0 : stoi(args[0]);
-                ostringstream oss;
-                oss << fixed << setprecision(precision) << num;
-                return oss.str();
-            } catch (...) {
-                return value;
+            case FilterId::Trim: {
+                string result = value;
+                result.erase(0, result.find_first_not_of(" \t\n\r"));
+                result.erase(result.find_last_not_of(" \t\n\r") + 1);
+                return result;
             }
-        }
-        
-        // Date/Time filters
-        if (filter == "date") {
-            try {
-                // Parse timestamp or date string
-                time_t timestamp = stoll(value);
-                struct tm* timeinfo = localtime(&timestamp);
-                string format = args.empty() ? "%Y-%m-%d" : args[0];
-                
-                char buffer[256];
-                strftime(buffer, sizeof(buffer), format.c_str(), timeinfo);
-                return string(buffer);
-            } catch (...) {
-                return value;
+            case FilterId::Length:
+                return to_string(value.length());
+            case FilterId::Capitalize: {
+                string result = value;
+                if (!result.empty()) {
+                    result[0] = toupper(result[0]);
+                }
+                return result;
             }
-        }
-        
-        if (filter == "time") {
-            try {
-                time_t timestamp = stoll(value);
-                struct tm* timeinfo = localtime(&timestamp);
-                string format = args.empty() ? "%H:%M:%S" : args[0];
-                
-                char buffer[256];
-                strftime(buffer, sizeof(buffer), format.c_str(), timeinfo);
-                return string(buffer);
-            } catch (...) {
-                return value;
+            case FilterId::Reverse: {
+                string result = value;
+                reverse(result.begin(), result.end());
+                return result;
             }
-        }
-        
-        if (filter == "datetime") {
-            try {
-                time_t timestamp = stoll(value);
-                struct tm* timeinfo = localtime(&timestamp);
-                string format = args.empty() ? "%Y-%m-%d %H:%M:%S" : args[0];
-                
-                char buffer[256];
-                strftime(buffer, sizeof(buffer), format.c_str(), timeinfo);
-                return string(buffer);
-            } catch (...) {
+            case FilterId::Truncate: {
+                size_t len = args.empty() ? 50 : stoi(args[0]);
+                if (value.length() > len) {
+                    return value.substr(0, len) + "...";
+                }
                 return value;
             }
-        }
+            case FilterId::Replace:
+                if (args.size() >= 2) {
+                    string result = value;
+                    string from = args[0];
+                    string to = args[1];
+                    size_t pos = 0;
+                    while ((pos = result.find(from, pos)) != string::npos) {
+                        result.replace(pos, from.length(), to);
+                        pos += to.length();
+                    }
+                    return result;
+                }
+                return value;
+            case FilterId::Default:
+                return value.empty() && !args.empty() ? args[0] : value;
+            case FilterId::First:
+                return value.empty() ? "" : string(1, value[0]);
+            case FilterId::Last:
+                return value.empty() ? "" : string(1, value.back());
+            case FilterId::Round:
+                try {
+                    double num = stod(value);
+                    int precision = args.empty() ? 0 : stoi(args[0]);
+                    ostringstream oss;
+                    oss << fixed << setprecision(precision) << num;
+                    return oss.str();
+                } catch (...) {
+                    return value;
+                }
 
-        if (filter == "base64_encode") {
-            return this->base64_encode(value);
-        }
-        if (filter == "base64_decode" || filter == "base64") {
-            return this->base64_decode(value);
-        }
+            // Date/Time filters
+            case FilterId::Date:
+            case FilterId::Time:
+            case FilterId::DateTime:
+                try {
+                    // Parse timestamp or date string
+                    time_t timestamp = stoll(value);
+                    struct tm timeinfo = local_time(timestamp);
+                    const char* default_format = filter.id == FilterId::Date ? "%Y-%m-%d"
+                                               : filter.id == FilterId::Time ? "%H:%M:%S"
+                                               : "%Y-%m-%d %H:%M:%S";
+                    string format = args.empty() ? default_format : args[0];
 
-        if (filter == "endswith") {
-            cout << "DEBUG: endswith filter called with value: '" << value << "', args size: " << args.size() << endl;
-            if (args.empty()) {
-                //cout << "DEBUG: endswith called with no args" << endl;
-                return "false";
-            }
-            //cout << "DEBUG: endswith checking '" << value << "' ends with '" << args[0] << "'" << endl;
-            bool result = string_endswith(value, args[0]);
-            //cout << "DEBUG: endswith result: " << (result ? "true" : "false") << endl;
-            return result ? "true" : "false";
-        }
+                    char buffer[256];
+                    strftime(buffer, sizeof(buffer), format.c_str(), &timeinfo);
+                    return string(buffer);
+                } catch (...) {
+                    return value;
+                }
 
-        if (filter == "startswith") {
-            if (args.empty()) return "false";
-            return string_startswith(value, args[0]) ? "true" : "false";
-        }
+            case FilterId::Base64Encode:
+                return this->base64_encode(value);
+            case FilterId::Base64Decode:
+                return this->base64_decode(value);
 
-        if (filter == "contains") {
-            if (args.empty()) return "false";
-            return string_contains(value, args[0]) ? "true" : "false";
-        }
-        
-        if (filter == "join") {
-            return value; // For lists, handled separately
+            case FilterId::EndsWith:
+                cout << "DEBUG: endswith filter called with value: '" << value << "', args size: " << args.size() << endl;
+                if (args.empty()) {
+                    return "false";
+                }
+                return string_endswith(value, args[0]) ? "true" : "false";
+            case FilterId::StartsWith:
+                if (args.empty()) return "false";
+                return string_startswith(value, args[0]) ? "true" : "false";
+            case FilterId::Contains:
+                if (args.empty()) return "false";
+                return string_contains(value, args[0]) ? "true" : "false";
+
+            case FilterId::None:
+                break;
         }
-        
         return value;
     }
 
@@ -389,8 +607,11 @@ private:
             }
             
             if (inside_tag && (isalnum(src[i]) || src[i] == '_')) {
+                // Dotted names like w.translation stay one identifier
                 string id;
-                while (i < src.size() && (isalnum(src[i]) || src[i] == '_')) {
+                while (i < src.size() && (isalnum(src[i]) || src[i] == '_' ||
+                                          (src[i] == '.' && i + 1 < src.size() &&
+                                           (isalnum(src[i + 1]) || src[i + 1] == '_')))) {
                     id += src[i++];
                 }
                 if (id == "true" || id == "false") {
@@ -421,651 +642,768 @@ private:
         return tokens;
     }
     
-    size_t skip_whitespace(const vector<Token>& tokens, size_t i) {
-        while (i < tokens.size() && tokens[i].type == TokenType::Whitespace) {
-            i++;
-        }
-        return i;
+    // ---- Compiled form ----
+    // The constructor lowers the tokens once into a flat instruction list.
+    // Block bodies are laid out inline and jump targets are resolved, so
+    // render() runs the list front to back without looking at tokens.
+    // Root names are interned into slots, looked up once per render; a
+    // dotted name becomes a path of fields read from its root. The lowering
+    // mirrors the token walk that rendering used to do, including how it
+    // treats malformed tags.
+
+    enum class OpCode : uint8_t {
+        Text,      // append text_pool[a, a + b)
+        Var,       // append path a through pipeline b
+        If,        // conditions [a, a + b); jump to c when false
+        Jump,      // jump to a
+        ForBegin,  // start loop a; jump to b when the list is missing or empty
+        ForNext,   // next item of loop a; jump back to b while items remain
+    };
+
+    struct Instr {
+        OpCode op;
+        uint32_t a, b, c;
+    };
+
+    struct Pipeline {
+        vector<FilterCall> filters;
+        bool escape;  // html-escape the result; off after raw, escape, url_encode or js_escape
+    };
+
+    enum class CompareOp : uint8_t { None, Add, Sub, Mul, Div, Eq, Ne, Gt, Lt, Ge, Le, Unknown };
+
+    static constexpr uint32_t no_slot = UINT32_MAX;
+    static constexpr size_t no_index = SIZE_MAX;
+
+    // One step of a dotted name: a field, or a list index when numeric
+    struct Step {
+        string name;
+        size_t index;
+    };
+
+    struct Path {
+        uint32_t slot;
+        vector<Step> steps;
+    };
+
+    // A condition operand: a literal or a path, optionally passed through
+    // one filter
+    struct Operand {
+        bool variable = false;
+        string literal;
+        uint32_t path = 0;
+        bool filtered = false;
+        FilterCall filter;
+    };
+
+    struct Condition {
+        Operand left;
+        CompareOp op;
+        Operand right;
+        bool negate;
+        char logic;  // how the next condition combines: 'a'nd, 'o'r or 0
+    };
+
+    struct Loop {
+        uint32_t list_path;
+        uint32_t list_slot;  // a plain name also found in lists; no_slot for paths
+        uint32_t var_slot;
+        uint32_t body_begin, body_end;  // instructions, ForNext excluded
+        // loop_index, loop_index0, loop_first, loop_last, loop_length,
+        // loop_even, loop_odd; no_slot unless the body reads them outside
+        // of nested loops, which bind their own
+        uint32_t meta[7];
+    };
+
+    vector<Instr> code;
+    string text_pool;
+    vector<string> var_names;
+    vector<string> list_names;
+    unordered_map<string, uint32_t> var_slots;
+    unordered_map<string, uint32_t> list_slots;
+    vector<Path> paths;
+    vector<Pipeline> pipelines;
+    vector<Condition> conditions;
+    vector<Loop> loops;
+    size_t loop_depth = 0;      // deepest loop nesting
+    size_t label = SIZE_MAX;    // a jump lands on the next instruction
+
+    uint32_t var_slot(const string& name) {
+        auto [it, inserted] = var_slots.emplace(name, (uint32_t)var_names.size());
+        if (inserted) var_names.push_back(name);
+        return it->second;
     }
-    
-    string resolve_value(const string& token_value, TokenType token_type, 
-                         const unordered_map<string, string>& vars,
-                         const unordered_map<string, vector<string>>& lists) {
-        if (token_type == TokenType::String || token_type == TokenType::Number || token_type == TokenType::Boolean) {
-            return token_value;
-        }
-        if (token_type == TokenType::Identifier) {
-            // Check for dictionary access (dot notation)
-            size_t dot_pos = token_value.find('.');
-            if (dot_pos != string::npos) {
-                string dict_name = token_value.substr(0, dot_pos);
-                string key = token_value.substr(dot_pos + 1);
-                
-                auto dict_it = dictionaries.find(dict_name);
-                if (dict_it != dictionaries.end()) {
-                    return dict_it->second.get(key);
-                }
-            }
-            
-            auto it = vars.find(token_value);
-            if (it != vars.end()) return it->second;
-            
-            auto lit = lists.find(token_value);
-            if (lit != lists.end()) return to_string(lit->second.size());
-            
-            return "";
-        }
-        return "";
+
+    uint32_t list_slot(const string& name) {
+        auto [it, inserted] = list_slots.emplace(name, (uint32_t)list_names.size());
+        if (inserted) list_names.push_back(name);
+        return it->second;
     }
 
-    // Separate function for arithmetic operations
-    string perform_arithmetic(const string& left_val, const string& right_val, const string& op) {
-        try {
-            double left_num = stod(left_val);
-            double right_num = stod(right_val);
-            double result = 0;
-            
-            if (op == "+") result = left_num + right_num;
-            else if (op == "-") result = left_num - right_num;
-            else if (op == "*") result = left_num * right_num;
-            else if (op == "/") result = left_num / right_num;
-            
-            return to_string(result);
-        } catch (...) {
-            return ""; // Return empty string if arithmetic fails
+    uint32_t path(const string& name) {
+        Path p;
+        size_t dot = name.find('.');
+        p.slot = var_slot(name.substr(0, dot));
+        while (dot != string::npos) {
+            size_t next = name.find('.', dot + 1);
+            string field = name.substr(dot + 1, next == string::npos ? string::npos : next - dot - 1);
+            bool numeric = all_of(field.begin(), field.end(), [](char c) { return isdigit((unsigned char)c); });
+            size_t index = numeric && field.size() < 19 ? stoull(field) : no_index;
+            p.steps.push_back({std::move(field), index});
+            dot = next;
         }
+        paths.push_back(std::move(p));
+        return (uint32_t)paths.size() - 1;
     }
 
-    bool evaluate_condition(const string& left_operand, TokenType left_type,
-                           const string& op, const string& right_operand, 
-                           TokenType right_type, 
-                           const unordered_map<string, string>& vars,
-                           const unordered_map<string, vector<string>>& lists) {
-        if (op.empty()) {
-            string val = resolve_value(left_operand, left_type, vars, lists);
-            return !val.empty() && val != "0" && val != "false";
-        }
-        
-        string left_val = resolve_value(left_operand, left_type, vars, lists);
-        string right_val = resolve_value(right_operand, right_type, vars, lists);
-        
-        // Handle arithmetic operations
-        if (op == "+" || op == "-" || op == "*" || op == "/") {
-            // Arithmetic operations return string, so we can't use them directly
-            // Use them for math in other contexts, but for comparison we treat them as numeric comparison
-            try {
-                double left_num = stod(left_val);
-                double right_num = stod(right_val);
-                
-                if (op == "+") return left_num + right_num;
-                if (op == "-") return left_num - right_num;
-                if (op == "*") return left_num * right_num;
-                if (op == "/") return left_num / right_num;
-            } catch (...) {
-                return false; // Can't perform arithmetic on non-numbers
-            }
-        }
-        
-        if (op == "==") return left_val == right_val;
-        if (op == "!=") return left_val != right_val;
-        
-        if (op == ">" || op == "<" || op == ">=" || op == "<=") {
-            try {
-                double left_num = stod(left_val);
-                double right_num = stod(right_val);
-                
-                if (op == ">") return left_num > right_num;
-                if (op == "<") return left_num < right_num;
-                if (op == ">=") return left_num >= right_num;
-                if (op == "<=") return left_num <= right_num;
-            } catch (...) {
-                if (op == ">") return left_val > right_val;
-                if (op == "<") return left_val < right_val;
-                if (op == ">=") return left_val >= right_val;
-                if (op == "<=") return left_val <= right_val;
-            }
-        }
-        
-        return false;
+    uint32_t emit(OpCode op, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0) {
+        code.push_back({op, a, b, c});
+        return (uint32_t)code.size() - 1;
     }
 
-    // Helper function to find the colon in ternary operator
-    size_t find_ternary_colon(const vector<Token>& tokens, size_t start_pos) {
-        size_t pos = start_pos;
-        int brace_depth = 0;
-        int bracket_depth = 0;
-        
-        while (pos < tokens.size()) {
-            if (tokens[pos].type == TokenType::VarClose) {
-                break;
-            }
-            
-            if (tokens[pos].type == TokenType::Operator && tokens[pos].value == ":" && 
-                brace_depth == 0 && bracket_depth == 0) {
-                return pos;
-            }
-            
-            if (tokens[pos].type == TokenType::Text) {
-                for (char c : tokens[pos].value) {
-                    if (c == '(') brace_depth++;
-                    else if (c == ')') brace_depth--;
-                    else if (c == '[') bracket_depth++;
-                    else if (c == ']') bracket_depth--;
-                }
-            }
-            
-            pos++;
-        }
-        return string::npos;
+    // Position of the next instruction, as a jump target
+    uint32_t here() {
+        label = code.size();
+        return (uint32_t)code.size();
     }
-    
-    // Helper function to find the closing }}
-    size_t find_var_close(const vector<Token>& tokens, size_t start_pos) {
-        size_t pos = start_pos;
-        while (pos < tokens.size()) {
-            if (tokens[pos].type == TokenType::VarClose) {
-                return pos;
-            }
-            pos++;
+
+    void emit_text(const string& text) {
+        if (text.empty()) return;
+        // Adjacent text merges, unless a jump lands between the two
+        if (!code.empty() && code.back().op == OpCode::Text && label != code.size()) {
+            code.back().b += (uint32_t)text.size();
+        } else {
+            emit(OpCode::Text, (uint32_t)text_pool.size(), (uint32_t)text.size());
         }
-        return string::npos;
+        text_pool += text;
     }
-    
-    // Helper function to evaluate ternary condition using your existing logic
-    string evaluate_ternary_condition(const vector<Token>& tokens, size_t start_pos, size_t end_pos,
-                                     const unordered_map<string, string>& vars,
-                                     const unordered_map<string, vector<string>>& lists) {
-        // Parse: left_operand operator right_operand
-        size_t pos = start_pos;
-        
-        // Skip whitespace
-        while (pos < end_pos && tokens[pos].type == TokenType::Whitespace) {
-            pos++;
-        }
-        
-        // Get left operand
-        string left_operand = "";
-        TokenType left_type = TokenType::Text;
-        if (pos < end_pos) {
-            if (tokens[pos].type == TokenType::Identifier) {
-                left_operand = tokens[pos].value;
-                left_type = TokenType::Identifier;
-            } else if (tokens[pos].type == TokenType::String) {
-                left_operand = tokens[pos].value;
-                left_type = TokenType::String;
-            } else if (tokens[pos].type == TokenType::Number) {
-                left_operand = tokens[pos].value;
-                left_type = TokenType::Number;
-            } else if (tokens[pos].type == TokenType::Boolean) {
-                left_operand = tokens[pos].value;
-                left_type = TokenType::Boolean;
-            }
-        }
-        
-        // Skip to operator
-        pos++;
-        while (pos < end_pos && tokens[pos].type == TokenType::Whitespace) {
-            pos++;
-        }
-        
-        // Get operator
-        string op = "";
-        if (pos < end_pos && tokens[pos].type == TokenType::Operator) {
-            op = tokens[pos].value;
-        }
-        
-        // Skip to right operand
-        pos++;
-        while (pos < end_pos && tokens[pos].type == TokenType::Whitespace) {
-            pos++;
-        }
-        
-        // Get right operand
-        string right_operand = "";
-        TokenType right_type = TokenType::Text;
-        if (pos < end_pos) {
-            if (tokens[pos].type == TokenType::Identifier) {
-                right_operand = tokens[pos].value;
-                right_type = TokenType::Identifier;
-            } else if (tokens[pos].type == TokenType::String) {
-                right_operand = tokens[pos].value;
-                right_type = TokenType::String;
-            } else if (tokens[pos].type == TokenType::Number) {
-                right_operand = tokens[pos].value;
-                right_type = TokenType::Number;
-            } else if (tokens[pos].type == TokenType::Boolean) {
-                right_operand = tokens[pos].value;
-                right_type = TokenType::Boolean;
-            }
+
+    static CompareOp compare_op(const string& op) {
+        if (op.empty()) return CompareOp::None;
+        if (op == "+") return CompareOp::Add;
+        if (op == "-") return CompareOp::Sub;
+        if (op == "*") return CompareOp::Mul;
+        if (op == "/") return CompareOp::Div;
+        if (op == "==") return CompareOp::Eq;
+        if (op == "!=") return CompareOp::Ne;
+        if (op == ">") return CompareOp::Gt;
+        if (op == "<") return CompareOp::Lt;
+        if (op == ">=") return CompareOp::Ge;
+        if (op == "<=") return CompareOp::Le;
+        return CompareOp::Unknown;
+    }
+
+    Operand operand(const Token& tok) {
+        Operand o;
+        if (tok.type == TokenType::Identifier) {
+            o.variable = true;
+            o.path = path(tok.value);
+        } else {
+            o.literal = tok.value;
         }
-        
-        // Use your existing evaluation logic
-        bool result = evaluate_condition(left_operand, left_type, op, right_operand, right_type, vars, lists);
-        return result ? "true" : "false";
+        return o;
     }
-    
-    // Helper function to extract ternary value (simple text/var extraction)
-    string extract_ternary_value(const vector<Token>& tokens, size_t start_pos, size_t end_pos,
-                                const unordered_map<string, string>& vars,
-                                const unordered_map<string, vector<string>>& lists) {
-        string value = "";
-        size_t pos = start_pos;
-        
-        while (pos < end_pos && pos < tokens.size()) {
-            if (tokens[pos].type == TokenType::Identifier) {
-                auto it = vars.find(tokens[pos].value);
-                if (it != vars.end()) {
-                    value += it->second;
-                } else {
-                    // Handle simple literals
-                    if (tokens[pos].value == "true" || tokens[pos].value == "false") {
-                        value += tokens[pos].value;
-                    }
+
+    static bool is_value(const Token& tok) {
+        return tok.type == TokenType::String || tok.type == TokenType::Number ||
+               tok.type == TokenType::Identifier || tok.type == TokenType::Boolean;
+    }
+
+    // Lowers tokens[begin, end), the way a render of just those tokens
+    // would walk them
+    void compile_range(const vector<Token>& tokens, size_t begin, size_t end, size_t depth) {
+        auto skip_whitespace = [&](size_t i) {
+            while (i < end && tokens[i].type == TokenType::Whitespace) i++;
+            return i;
+        };
+        // Past a closing {% name %}; i stays put when there is none
+        auto close_block = [&](size_t j, size_t& i) {
+            if (j < end && tokens[j].type == TokenType::TagOpen) {
+                j = skip_whitespace(j + 1);
+                if (j < end && tokens[j].type == TokenType::Identifier) {
+                    j = skip_whitespace(j + 1);
+                    if (j < end && tokens[j].type == TokenType::TagClose) i = j;
                 }
-            } else if (tokens[pos].type == TokenType::String) {
-                value += tokens[pos].value;
-            } else if (tokens[pos].type == TokenType::Number) {
-                value += tokens[pos].value;
-            } else if (tokens[pos].type == TokenType::Boolean) {
-                value += tokens[pos].value;
-            } else if (tokens[pos].type == TokenType::Whitespace) {
-                value += tokens[pos].value;
-            } else if (tokens[pos].type == TokenType::Text) {
-                value += tokens[pos].value;
             }
-            pos++;
-        }
-        
-        return value;
-    }
+        };
 
-    string render_internal(const vector<Token>& tokens,
-                          const unordered_map<string, string>& vars,
-                          const unordered_map<string, vector<string>>& lists) {
-        string output;
-        size_t i = 0;
-        
-        while (i < tokens.size()) {
+        size_t i = begin;
+        while (i < end) {
             const Token& tok = tokens[i];
-            
+
             if (tok.type == TokenType::Text || tok.type == TokenType::Whitespace) {
-                output += tok.value;
+                emit_text(tok.value);
             }
             else if (tok.type == TokenType::CommentOpen) {
-                while (i < tokens.size() && tokens[i].type != TokenType::CommentClose) {
+                while (i < end && tokens[i].type != TokenType::CommentClose) {
                     i++;
                 }
             }
             else if (tok.type == TokenType::VarOpen) {
-                size_t j = skip_whitespace(tokens, i + 1);
-                
-                if (j < tokens.size() && tokens[j].type == TokenType::Identifier) {
-                    string var_name = tokens[j].value;
-                    j = skip_whitespace(tokens, j + 1);
-                    
-                    // Check for ternary operator: ?
-                    if (j < tokens.size() && tokens[j].type == TokenType::Operator && tokens[j].value == "?") {
-                        // Parse ternary expression: {{ condition ? true_value : false_value }}
-                        size_t colon_pos = find_ternary_colon(tokens, j + 1);
-                        size_t var_close_pos = find_var_close(tokens, j + 1);
-                        
-                        if (colon_pos != string::npos && var_close_pos != string::npos && colon_pos < var_close_pos) {
-                            // Extract and evaluate the condition
-                            string condition_result = evaluate_ternary_condition(tokens, j + 1, colon_pos, vars, lists);
-                            
-                            // Extract true and false values
-                            string true_value = extract_ternary_value(tokens, j + 1, colon_pos, vars, lists);
-                            string false_value = extract_ternary_value(tokens, colon_pos + 1, var_close_pos, vars, lists);
-                            
-                            string result = (condition_result == "true") ? true_value : false_value;
-                            output += result;
-                            i = var_close_pos;
-                        }
-                    } else {
-                        // Original variable handling with filters
-                        vector<string> filters;
-                        vector<vector<string>> filter_args;
-                        
-                        while (j < tokens.size() && tokens[j].type == TokenType::Pipe) {
-                            j = skip_whitespace(tokens, j + 1);
-                            if (j < tokens.size() && tokens[j].type == TokenType::Identifier) {
-                                string filter_name = tokens[j].value;
-                                filters.push_back(filter_name);
-                                j = skip_whitespace(tokens, j + 1);
-                                
-                                // Collect arguments for this filter
-                                vector<string> args;
-                                while (j < tokens.size() && 
-                                       (tokens[j].type == TokenType::String || 
-                                        tokens[j].type == TokenType::Number ||
-                                        tokens[j].type == TokenType::Identifier ||
-                                        tokens[j].type == TokenType::Boolean)) {
-                                    args.push_back(tokens[j].value);
-                                    j = skip_whitespace(tokens, j + 1);
-                                }
-                                filter_args.push_back(args);
+                size_t j = skip_whitespace(i + 1);
+
+                if (j < end && tokens[j].type == TokenType::Identifier) {
+                    const string& var_name = tokens[j].value;
+                    j = skip_whitespace(j + 1);
+
+                    Pipeline pipeline{{}, true};
+                    while (j < end && tokens[j].type == TokenType::Pipe) {
+                        j = skip_whitespace(j + 1);
+                        if (j < end && tokens[j].type == TokenType::Identifier) {
+                            FilterCall filter{tokens[j].value, filter_id(tokens[j].value), {}};
+                            j = skip_whitespace(j + 1);
+                            while (j < end && is_value(tokens[j])) {
+                                filter.args.push_back(tokens[j].value);
+                                j = skip_whitespace(j + 1);
                             }
-                        }
-                        
-                        if (j < tokens.size() && tokens[j].type == TokenType::VarClose) {
-                            auto it = vars.find(var_name);
-                            if (it != vars.end()) {
-                                string value = it->second;
-                                
-                                bool has_raw_filter = false;
-                                bool has_special_escape_filter = false;
-                                
-                                // Apply filters
-                                for (size_t k = 0; k < filters.size(); k++) {
-                                    const string& filter = filters[k];
-                                    const vector<string>& args = (k < filter_args.size()) ? filter_args[k] : vector<string>();
-                                    
-                                    if (filter == "raw") {
-                                        has_raw_filter = true;
-                                    } else if (filter == "url_encode" || filter == "js_escape" || filter == "escape") {
-                                        has_special_escape_filter = true;
-                                    }
-                                    value = apply_filter(value, filter, args);
-                                }
-                                
-                                if (!has_raw_filter && !has_special_escape_filter) {
-                                    value = html_escape(value);
-                                }
-                                
-                                output += value;
+                            if (filter.name == "raw" || filter.name == "url_encode" ||
+                                filter.name == "js_escape" || filter.name == "escape") {
+                                pipeline.escape = false;
                             }
-                            i = j;
+                            pipeline.filters.push_back(std::move(filter));
                         }
                     }
+
+                    if (j < end && tokens[j].type == TokenType::VarClose) {
+                        pipelines.push_back(std::move(pipeline));
+                        emit(OpCode::Var, path(var_name), (uint32_t)pipelines.size() - 1);
+                        i = j;
+                    }
                 }
             }
             else if (tok.type == TokenType::TagOpen) {
-                size_t j = skip_whitespace(tokens, i + 1);
-                
-                if (j < tokens.size() && tokens[j].type == TokenType::Identifier) {
-                    string keyword = tokens[j].value;
-                    
-                    if (keyword == "for") {
-                        j = skip_whitespace(tokens, j + 1);
-                        
-                        if (j >= tokens.size() || tokens[j].type != TokenType::Identifier) {
-                            i++;
-                            continue;
-                        }
-                        string loop_var = tokens[j].value;
-                        j = skip_whitespace(tokens, j + 1);
-                        
-                        if (j >= tokens.size() || tokens[j].type != TokenType::Identifier || tokens[j].value != "in") {
-                            i++;
-                            continue;
-                        }
-                        j = skip_whitespace(tokens, j + 1);
-                        
-                        if (j >= tokens.size() || tokens[j].type != TokenType::Identifier) {
-                            i++;
-                            continue;
-                        }
-                        string list_name = tokens[j].value;
-                        j = skip_whitespace(tokens, j + 1);
-                        
-                        if (j >= tokens.size() || tokens[j].type != TokenType::TagClose) {
-                            i++;
-                            continue;
-                        }
-                        j++;
-                        
-                        vector<Token> loop_body;
-                        int nested = 0;
-                        
-                        while (j < tokens.size()) {
-                            if (tokens[j].type == TokenType::TagOpen) {
-                                size_t peek = skip_whitespace(tokens, j + 1);
-                                if (peek < tokens.size() && tokens[peek].type == TokenType::Identifier) {
-                                    if (tokens[peek].value == "for") {
-                                        nested++;
-                                    } else if (tokens[peek].value == "endfor") {
-                                        if (nested == 0) break;
-                                        nested--;
-                                    }
+                size_t j = skip_whitespace(i + 1);
+
+                if (j < end && tokens[j].type == TokenType::Identifier && tokens[j].value == "for") {
+                    j = skip_whitespace(j + 1);
+                    if (j >= end || tokens[j].type != TokenType::Identifier) {
+                        i++;
+                        continue;
+                    }
+                    const string& loop_var = tokens[j].value;
+                    if (loop_var.find('.') != string::npos) {
+                        i++;
+                        continue;
+                    }
+                    j = skip_whitespace(j + 1);
+                    if (j >= end || tokens[j].type != TokenType::Identifier || tokens[j].value != "in") {
+                        i++;
+                        continue;
+                    }
+                    j = skip_whitespace(j + 1);
+                    if (j >= end || tokens[j].type != TokenType::Identifier) {
+                        i++;
+                        continue;
+                    }
+                    const string& list_name = tokens[j].value;
+                    j = skip_whitespace(j + 1);
+                    if (j >= end || tokens[j].type != TokenType::TagClose) {
+                        i++;
+                        continue;
+                    }
+                    j++;
+
+                    size_t body = j;
+                    int nested = 0;
+                    while (j < end) {
+                        if (tokens[j].type == TokenType::TagOpen) {
+                            size_t peek = skip_whitespace(j + 1);
+                            if (peek < end && tokens[peek].type == TokenType::Identifier) {
+                                if (tokens[peek].value == "for") {
+                                    nested++;
+                                } else if (tokens[peek].value == "endfor") {
+                                    if (nested == 0) break;
+                                    nested--;
                                 }
                             }
-                            loop_body.push_back(tokens[j]);
-                            j++;
                         }
-                        
-                        auto list_it = lists.find(list_name);
-                        if (list_it != lists.end()) {
-                            size_t index = 0;
-                            for (const auto& val : list_it->second) {
-                                auto loop_vars = vars;
-                                loop_vars[loop_var] = val;
-                                
-                                // Add loop variables
-                                loop_vars["loop_index"] = to_string(index + 1);
-                                loop_vars["loop_index0"] = to_string(index);
-                                loop_vars["loop_first"] = (index == 0) ? "true" : "false";
-                                loop_vars["loop_last"] = (index == list_it->second.size() - 1) ? "true" : "false";
-                                loop_vars["loop_length"] = to_string(list_it->second.size());
-                                loop_vars["loop_even"] = ((index + 1) % 2 == 0) ? "true" : "false";
-                                loop_vars["loop_odd"] = ((index + 1) % 2 == 1) ? "true" : "false";
-                                
-                                output += render_internal(loop_body, loop_vars, lists);
-                                index++;
-                            }
+                        j++;
+                    }
+
+                    uint32_t loop = (uint32_t)loops.size();
+                    bool plain = list_name.find('.') == string::npos;
+                    uint32_t source = path(list_name);
+                    loops.push_back({source, plain ? list_slot(list_name) : no_slot, var_slot(loop_var), 0, 0, {}});
+                    loop_depth = max(loop_depth, depth + 1);
+                    uint32_t begin_at = emit(OpCode::ForBegin, loop);
+                    uint32_t body_at = here();
+                    compile_range(tokens, body, j, depth + 1);
+                    loops[loop].body_begin = body_at;
+                    loops[loop].body_end = emit(OpCode::ForNext, loop, body_at);
+                    code[begin_at].b = here();
+
+                    close_block(j, i);
+                }
+                else if (j < end && tokens[j].type == TokenType::Identifier && tokens[j].value == "if") {
+                    j = skip_whitespace(j + 1);
+
+                    vector<Condition> conds;
+                    while (true) {
+                        bool is_not = false;
+                        if (j < end && tokens[j].type == TokenType::Identifier && tokens[j].value == "not") {
+                            is_not = true;
+                            j = skip_whitespace(j + 1);
                         }
-                        
-                        if (j < tokens.size() && tokens[j].type == TokenType::TagOpen) {
-                            j = skip_whitespace(tokens, j + 1);
-                            if (j < tokens.size() && tokens[j].type == TokenType::Identifier) {
-                                j = skip_whitespace(tokens, j + 1);
-                                if (j < tokens.size() && tokens[j].type == TokenType::TagClose) {
-                                    i = j;
-                                }
-                            }
+
+                        if (j >= end || (tokens[j].type != TokenType::Identifier &&
+                                         tokens[j].type != TokenType::Boolean &&
+                                         tokens[j].type != TokenType::String &&
+                                         tokens[j].type != TokenType::Number)) {
+                            break;
                         }
-                    }
-                    else if (keyword == "if") {
-                        j = skip_whitespace(tokens, j + 1);
-                        
-                        vector<tuple<string, TokenType, string, string, TokenType, string>> conditions;
-                        
-                        while (true) {
-                            bool is_not = false;
-                            if (j < tokens.size() && tokens[j].type == TokenType::Identifier && tokens[j].value == "not") {
-                                is_not = true;
-                                j = skip_whitespace(tokens, j + 1);
-                            }
-                            
-                            if (j >= tokens.size() || 
-                                (tokens[j].type != TokenType::Identifier && 
-                                 tokens[j].type != TokenType::Boolean &&
-                                 tokens[j].type != TokenType::String &&
-                                 tokens[j].type != TokenType::Number)) {
-                                break;
-                            }
-                            
-                            string left_operand = tokens[j].value;
-                            TokenType left_type = tokens[j].type;
-                            j = skip_whitespace(tokens, j + 1);
-
-                            // **NEW: Handle filters in if conditions**
-                            string filter_value = left_operand;
-                            TokenType filter_type = left_type;
-                            
-                            // Check for filters after the left operand
-                            if (j < tokens.size() && tokens[j].type == TokenType::Pipe) {
-                                j = skip_whitespace(tokens, j + 1);
-                                if (j < tokens.size() && tokens[j].type == TokenType::Identifier) {
-                                    string filter_name = tokens[j].value;
-                                    j = skip_whitespace(tokens, j + 1);
-                                    
-                                    // Collect filter arguments
-                                    vector<string> filter_args;
-                                    while (j < tokens.size() && 
-                                           (tokens[j].type == TokenType::String || 
-                                            tokens[j].type == TokenType::Number ||
-                                            tokens[j].type == TokenType::Identifier ||
-                                            tokens[j].type == TokenType::Boolean)) {
-                                        filter_args.push_back(tokens[j].value);
-                                        j = skip_whitespace(tokens, j + 1);
-                                    }
-                                    
-                                    // Apply the filter to get the actual value for comparison
-                                    string original_value = resolve_value(left_operand, left_type, vars, lists);
-                                    filter_value = apply_filter(original_value, filter_name, filter_args);
-                                    filter_type = TokenType::String; // Filter results are always strings
-                                    
-                                    //cout << "DEBUG: Applied filter " << filter_name << " to '" << left_operand << "' -> '" << filter_value << "'" << endl;
-                                }
-                            }
 
-                            string op = "";
-                            string right_operand = "";
-                            TokenType right_type = TokenType::Text;
-                            
-                            if (j < tokens.size() && tokens[j].type == TokenType::Operator) {
-                                op = tokens[j].value;
-                                j = skip_whitespace(tokens, j + 1);
-                                
-                                if (j < tokens.size() && 
-                                    (tokens[j].type == TokenType::Identifier || 
-                                     tokens[j].type == TokenType::Number ||
-                                     tokens[j].type == TokenType::String ||
-                                     tokens[j].type == TokenType::Boolean)) {
-                                    right_operand = tokens[j].value;
-                                    right_type = tokens[j].type;
-                                    j = skip_whitespace(tokens, j + 1);
+                        Condition cond{operand(tokens[j]), CompareOp::None, {}, is_not, 0};
+                        j = skip_whitespace(j + 1);
+
+                        // One filter may follow the left operand
+                        if (j < end && tokens[j].type == TokenType::Pipe) {
+                            j = skip_whitespace(j + 1);
+                            if (j < end && tokens[j].type == TokenType::Identifier) {
+                                cond.left.filtered = true;
+                                cond.left.filter = {tokens[j].value, filter_id(tokens[j].value), {}};
+                                j = skip_whitespace(j + 1);
+                                while (j < end && is_value(tokens[j])) {
+                                    cond.left.filter.args.push_back(tokens[j].value);
+                                    j = skip_whitespace(j + 1);
                                 }
                             }
-                            
-                            string logic_op = is_not ? "not" : "";
-                            
-                            if (j < tokens.size() && tokens[j].type == TokenType::Identifier && 
-                                (tokens[j].value == "and" || tokens[j].value == "or")) {
-                                logic_op = logic_op.empty() ? tokens[j].value : (logic_op + "_" + tokens[j].value);
-                                j = skip_whitespace(tokens, j + 1);
-                            }
-                            
-                            // Use the filtered value in the condition
-                            conditions.push_back({filter_value, filter_type, op, right_operand, right_type, logic_op});
-                            
-                            if (j < tokens.size() && tokens[j].type == TokenType::TagClose) {
-                                break;
+                        }
+
+                        if (j < end && tokens[j].type == TokenType::Operator) {
+                            cond.op = compare_op(tokens[j].value);
+                            j = skip_whitespace(j + 1);
+                            if (j < end && is_value(tokens[j])) {
+                                cond.right = operand(tokens[j]);
+                                j = skip_whitespace(j + 1);
                             }
                         }
-                        
-                        if (j >= tokens.size() || tokens[j].type != TokenType::TagClose) {
-                            i++;
-                            continue;
+
+                        if (j < end && tokens[j].type == TokenType::Identifier &&
+                            (tokens[j].value == "and" || tokens[j].value == "or")) {
+                            cond.logic = tokens[j].value[0];
+                            j = skip_whitespace(j + 1);
                         }
-                        j++;
-                        
-                        vector<pair<vector<tuple<string, TokenType, string, string, TokenType, string>>, vector<Token>>> branches;
-                        vector<Token> current_body;
-                        int nested = 0;
-                        
-                        branches.push_back({conditions, {}});
-                        
-                        while (j < tokens.size()) {
-                            if (tokens[j].type == TokenType::TagOpen) {
-                                size_t peek = skip_whitespace(tokens, j + 1);
-                                if (peek < tokens.size() && tokens[peek].type == TokenType::Identifier) {
-                                    string tag = tokens[peek].value;
-                                    
-                                    if (tag == "if") {
-                                        nested++;
-                                    } else if ((tag == "elsif" || tag == "elseif" || tag == "else") && nested == 0) {
-                                        branches.back().second = current_body;
-                                        current_body.clear();
-                                        
-                                        if (tag == "else") {
-                                            j = peek;
-                                            j = skip_whitespace(tokens, j + 1);
-                                            if (j < tokens.size() && tokens[j].type == TokenType::TagClose) {
-                                                j++;
-                                            }
-                                            branches.push_back({{}, {}});
-                                            continue;
+
+                        conds.push_back(std::move(cond));
+
+                        if (j < end && tokens[j].type == TokenType::TagClose) {
+                            break;
+                        }
+                    }
+
+                    if (j >= end || tokens[j].type != TokenType::TagClose) {
+                        i++;
+                        continue;
+                    }
+                    j++;
+
+                    // Branch bodies are token ranges. An elsif ends the body
+                    // before it but starts no branch of its own: its tag and
+                    // the tokens after it become the current branch's body.
+                    struct Branch {
+                        vector<Condition> conds;
+                        size_t begin = 0, end = 0;
+                    };
+                    vector<Branch> branches;
+                    branches.push_back({std::move(conds)});
+                    size_t current = j;
+                    int nested = 0;
+
+                    while (j < end) {
+                        if (tokens[j].type == TokenType::TagOpen) {
+                            size_t peek = skip_whitespace(j + 1);
+                            if (peek < end && tokens[peek].type == TokenType::Identifier) {
+                                const string& tag = tokens[peek].value;
+
+                                if (tag == "if") {
+                                    nested++;
+                                } else if ((tag == "elsif" || tag == "elseif" || tag == "else") && nested == 0) {
+                                    branches.back().begin = current;
+                                    branches.back().end = j;
+                                    current = j;
+
+                                    if (tag == "else") {
+                                        j = skip_whitespace(peek + 1);
+                                        if (j < end && tokens[j].type == TokenType::TagClose) {
+                                            j++;
                                         }
-                                    } else if (tag == "endif") {
-                                        if (nested == 0) break;
-                                        nested--;
+                                        branches.push_back({});
+                                        current = j;
+                                        continue;
                                     }
+                                } else if (tag == "endif") {
+                                    if (nested == 0) break;
+                                    nested--;
                                 }
                             }
-                            
-                            current_body.push_back(tokens[j]);
-                            j++;
-                        }
-                        
-                        if (!current_body.empty()) {
-                            branches.back().second = current_body;
-                        }
-                        
-                        for (const auto& [branch_conditions, body] : branches) {
-                            if (branch_conditions.empty()) {
-                                output += render_internal(body, vars, lists);
-                                break;
-                            }
-                            
-                            bool result = true;
-                            string last_logic = "";
-                            
-                            for (const auto& [left_op, left_t, op, right_op, right_t, logic] : branch_conditions) {
-                                bool cond = evaluate_condition(left_op, left_t, op, right_op, right_t, vars, lists);
-                                
-                                if (logic.find("not") != string::npos) {
-                                    cond = !cond;
-                                }
-                                
-                                if (last_logic == "and") {
-                                    result = result && cond;
-                                } else if (last_logic == "or") {
-                                    result = result || cond;
-                                } else {
-                                    result = cond;
-                                }
-                                
-                                if (logic.find("and") != string::npos) {
-                                    last_logic = "and";
-                                } else if (logic.find("or") != string::npos) {
-                                    last_logic = "or";
-                                } else {
-                                    last_logic = "";
-                                }
-                            }
-                            
-                            if (result) {
-                                output += render_internal(body, vars, lists);
-                                break;
-                            }
                         }
-                        
-                        if (j < tokens.size() && tokens[j].type == TokenType::TagOpen) {
-                            j = skip_whitespace(tokens, j + 1);
-                            if (j < tokens.size() && tokens[j].type == TokenType::Identifier) {
-                                j = skip_whitespace(tokens, j + 1);
-                                if (j < tokens.size() && tokens[j].type == TokenType::TagClose) {
-                                    i = j;
-                                }
-                            }
+                        j++;
+                    }
+                    if (j > current) {
+                        branches.back().begin = current;
+                        branches.back().end = j;
+                    }
+
+                    // The first branch whose conditions hold renders; one
+                    // without conditions always does
+                    vector<uint32_t> exits;
+                    for (Branch& branch : branches) {
+                        if (branch.conds.empty()) {
+                            compile_range(tokens, branch.begin, branch.end, depth);
+                            break;
                         }
+                        uint32_t test = emit(OpCode::If, (uint32_t)conditions.size(), (uint32_t)branch.conds.size());
+                        for (auto& c : branch.conds) conditions.push_back(std::move(c));
+                        compile_range(tokens, branch.begin, branch.end, depth);
+                        exits.push_back(emit(OpCode::Jump));
+                        code[test].c = here();
                     }
+                    uint32_t done = here();
+                    for (uint32_t exit : exits) code[exit].a = done;
+
+                    close_block(j, i);
                 }
             }
-            
+
             i++;
         }
-        
-        return output;
     }
 
-public:
-    unordered_map<string, string> vars;
-    unordered_map<string, vector<string>> lists;
+    void compile(const vector<Token>& tokens) {
+        compile_range(tokens, 0, tokens.size(), 0);
 
+        // Loop metadata is only kept up to date where something reads it
+        static const char* const meta_names[7] = {"loop_index", "loop_index0", "loop_first", "loop_last",
+                                                  "loop_length", "loop_even", "loop_odd"};
+        vector<bool> read(var_names.size());
+        for (Loop& loop : loops) {
+            fill(read.begin(), read.end(), false);
+            for (uint32_t ip = loop.body_begin; ip < loop.body_end; ip++) {
+                const Instr& in = code[ip];
+                if (in.op == OpCode::ForBegin) {
+                    ip = in.b - 1;  // nested loops shadow all of it
+                } else if (in.op == OpCode::Var) {
+                    read[paths[in.a].slot] = true;
+                } else if (in.op == OpCode::If) {
+                    for (uint32_t k = in.a; k < in.a + in.b; k++) {
+                        if (conditions[k].left.variable) read[paths[conditions[k].left.path].slot] = true;
+                        if (conditions[k].right.variable) read[paths[conditions[k].right.path].slot] = true;
+                    }
+                }
+            }
+            for (int m = 0; m < 7; m++) {
+                auto it = var_slots.find(meta_names[m]);
+                loop.meta[m] = it != var_slots.end() && read[it->second] ? it->second : no_slot;
+            }
+        }
+    }
+
+    // ---- Execution ----
+
+    struct LoopFrame {
+        const Loop* loop;
+        Value list;  // a borrowed or shared handle, never a copy of the items
+        size_t index, size;
+        Value item;  // the current item, when the list is borrowed
+        const Value* saved[8];  // the loop variable's and meta slots' outer values
+        string index1, index0, length;
+        Value index1_value, index0_value, length_value;  // refs to the strings above
+    };
+
+    static void append_escaped(string& out, const string& str) {
+        for (char c : str) {
+            switch (c) {
+                case '&': out += "&amp;"; break;
+                case '<': out += "&lt;"; break;
+                case '>': out += "&gt;"; break;
+                case '"': out += "&quot;"; break;
+                case '\'': out += "&#39;"; break;
+                default: out += c;
+            }
+        }
+    }
+
+    // Reuses out's buffer rather than building a new string
+    static const string& format_index(string& out, size_t n) {
+        char digits[20];
+        char* p = end(digits);
+        do {
+            *--p = char('0' + n % 10);
+            n /= 10;
+        } while (n);
+        out.assign(p, end(digits));
+        return out;
+    }
+
+    static void bind_loop(LoopFrame& f, vector<const Value*>& slots) {
+        static const Value yes(true), no(false);
+        const Loop& loop = *f.loop;
+        slots[loop.var_slot] = f.list.item(f.index, f.item);
+        const uint32_t* meta = loop.meta;
+        if (meta[0] != no_slot) format_index(f.index1, f.index + 1), slots[meta[0]] = &f.index1_value;
+        if (meta[1] != no_slot) format_index(f.index0, f.index), slots[meta[1]] = &f.index0_value;
+        if (meta[2] != no_slot) slots[meta[2]] = f.index == 0 ? &yes : &no;
+        if (meta[3] != no_slot) slots[meta[3]] = f.index == f.size - 1 ? &yes : &no;
+        if (meta[4] != no_slot) slots[meta[4]] = &f.length_value;
+        if (meta[5] != no_slot) slots[meta[5]] = (f.index + 1) % 2 == 0 ? &yes : &no;
+        if (meta[6] != no_slot) slots[meta[6]] = (f.index + 1) % 2 == 1 ? &yes : &no;
+    }
+
+    // Follows a path from its root slot; nullptr when a step is missing.
+    // Values built along the way go to hold, alternating so that a step
+    // never overwrites the value it reads from.
+    const Value* lookup(uint32_t p, const vector<const Value*>& slots, Value (&hold)[2]) const {
+        const Path& path = paths[p];
+        const Value* value = slots[path.slot];
+        for (size_t k = 0; value && k < path.steps.size(); k++) {
+            const Step& step = path.steps[k];
+            Value& scratch = hold[k & 1];
+            value = step.index != no_index && value->type() == Value::Type::List
+                        ? value->item(step.index, scratch)
+                        : value->field(step.name, scratch);
+        }
+        return value;
+    }
+
+    const string& resolve(const Operand& o, const vector<const Value*>& slots,
+                          Value (&hold)[2], string& scratch) const {
+        const string* value = &o.literal;
+        if (o.variable) {
+            const Value* found = lookup(o.path, slots, hold);
+            if (found) {
+                value = &found->text(scratch);
+            } else {
+                scratch.clear();
+                value = &scratch;
+            }
+        }
+        if (o.filtered) {
+            scratch = apply_filter(*value, o.filter);
+            value = &scratch;
+        }
+        return *value;
+    }
+
+    static bool compare(const string& left_val, CompareOp op, const string& right_val) {
+        switch (op) {
+            case CompareOp::None:
+                return !left_val.empty() && left_val != "0" && left_val != "false";
+            case CompareOp::Add:
+            case CompareOp::Sub:
+            case CompareOp::Mul:
+            case CompareOp::Div:
+                // Arithmetic holds when the result is non-zero
+                try {
+                    double left_num = stod(left_val);
+                    double right_num = stod(right_val);
+                    if (op == CompareOp::Add) return left_num + right_num != 0;
+                    if (op == CompareOp::Sub) return left_num - right_num != 0;
+                    if (op == CompareOp::Mul) return left_num * right_num != 0;
+                    return left_num / right_num != 0;
+                } catch (...) {
+                    return false; // Can't perform arithmetic on non-numbers
+                }
+            case CompareOp::Eq: return left_val == right_val;
+            case CompareOp::Ne: return left_val != right_val;
+            case CompareOp::Gt:
+            case CompareOp::Lt:
+            case CompareOp::Ge:
+            case CompareOp::Le:
+                try {
+                    double left_num = stod(left_val);
+                    double right_num = stod(right_val);
+                    if (op == CompareOp::Gt) return left_num > right_num;
+                    if (op == CompareOp::Lt) return left_num < right_num;
+                    if (op == CompareOp::Ge) return left_num >= right_num;
+                    return left_num <= right_num;
+                } catch (...) {
+                    if (op == CompareOp::Gt) return left_val > right_val;
+                    if (op == CompareOp::Lt) return left_val < right_val;
+                    if (op == CompareOp::Ge) return left_val >= right_val;
+                    return left_val <= right_val;
+                }
+            case CompareOp::Unknown:
+                break;
+        }
+        return false;
+    }
+
+    // Runs the program into output. With a writer, output is handed over
+    // and cleared whenever it reaches chunk_size, and the run stops early,
+    // returning false, once the writer refuses a chunk.
+    bool execute(const Context& context, string& output, const Writer* write) const {
+        const auto& [vars, lists, values, dictionaries] = context;
+        // Names resolve to vars, then lists, then bound values, then dicts;
+        // loop variables shadow all of them while their loop runs
+        vector<Value> roots(var_names.size());
+        vector<const Value*> slots(var_names.size());
+        for (size_t s = 0; s < var_names.size(); s++) {
+            const string& name = var_names[s];
+            if (auto it = vars.find(name); it != vars.end()) {
+                roots[s] = Value::ref(it->second);
+            } else if (auto it = lists.find(name); it != lists.end()) {
+                roots[s] = Value::ref(it->second);
+            } else if (auto it = values.find(name); it != values.end()) {
+                slots[s] = &it->second;
+                continue;
+            } else if (auto it = dictionaries.find(name); it != dictionaries.end()) {
+                roots[s] = Value::ref(it->second.values);
+            } else {
+                continue;
+            }
+            slots[s] = &roots[s];
+        }
+        // A for over a plain name takes a list of that name even where a
+        // var or loop variable hides it
+        vector<Value> list_values(list_names.size());
+        for (size_t s = 0; s < list_names.size(); s++) {
+            auto it = lists.find(list_names[s]);
+            if (it != lists.end()) list_values[s] = Value::ref(it->second);
+        }
+        // Frames hold the values loop slots point into; never reallocated
+        vector<LoopFrame> frames;
+        frames.reserve(loop_depth);
+
+        string text_scratch, left_scratch, right_scratch;
+        Value hold[2], left_hold[2], right_hold[2];
+        size_t ip = 0;
+        while (ip < code.size()) {
+            if (write && output.size() >= chunk_size) {
+                if (!(*write)(output.data(), output.size())) return false;
+                output.clear();
+            }
+            const Instr& in = code[ip];
+            switch (in.op) {
+                case OpCode::Text:
+                    output.append(text_pool, in.a, in.b);
+                    ip++;
+                    break;
+
+                case OpCode::Var: {
+                    ip++;
+                    const Value* found = lookup(in.a, slots, hold);
+                    if (!found) break;
+                    const Pipeline& pipeline = pipelines[in.b];
+                    const string* value = found->str();
+                    if (value && pipeline.filters.empty()) {
+                        append_escaped(output, *value);  // the common case
+                        break;
+                    }
+                    size_t first = 0;
+                    if (!value) {
+                        Value::Type type = found->type();
+                        if (type == Value::Type::List && !pipeline.filters.empty() &&
+                            pipeline.filters[0].id == FilterId::Length && !custom_filters.count("length")) {
+                            first = 1;  // a list's length is its item count, which text() gives
+                        } else if (type == Value::Type::Null || type == Value::Type::List || type == Value::Type::Map) {
+                            break;  // lists and maps print nothing of their own
+                        }
+                        value = &found->text(text_scratch);
+                    }
+                    if (pipeline.filters.size() == first) {
+                        append_escaped(output, *value);
+                        break;
+                    }
+                    string result = apply_filter(*value, pipeline.filters[first]);
+                    for (size_t k = first + 1; k < pipeline.filters.size(); k++) result = apply_filter(result, pipeline.filters[k]);
+                    if (pipeline.escape) append_escaped(output, result);
+                    else output += result;
+                    break;
+                }
+
+                case OpCode::If: {
+                    bool result = true;
+                    char last_logic = 0;
+                    for (uint32_t k = in.a; k < in.a + in.b; k++) {
+                        const Condition& c = conditions[k];
+                        const string& left = resolve(c.left, slots, left_hold, left_scratch);
+                        bool cond = c.op == CompareOp::None
+                                        ? compare(left, c.op, left)
+                                        : compare(left, c.op, resolve(c.right, slots, right_hold, right_scratch));
+                        if (c.negate) cond = !cond;
+                        if (last_logic == 'a') result = result && cond;
+                        else if (last_logic == 'o') result = result || cond;
+                        else result = cond;
+                        last_logic = c.logic;
+                    }
+                    ip = result ? ip + 1 : in.c;
+                    break;
+                }
+
+                case OpCode::Jump:
+                    ip = in.a;
+                    break;
+
+                case OpCode::ForBegin: {
+                    const Loop& loop = loops[in.a];
+                    const Value* list = lookup(loop.list_path, slots, hold);
+                    if ((!list || list->type() != Value::Type::List) && loop.list_slot != no_slot) {
+                        list = &list_values[loop.list_slot];
+                    }
+                    size_t size = list ? list->size() : 0;
+                    if (size == 0) {
+                        ip = in.b;
+                        break;
+                    }
+                    LoopFrame& f = frames.emplace_back();
+                    f.loop = &loop;
+                    f.list = *list;
+                    f.index = 0;
+                    f.size = size;
+                    f.saved[0] = slots[loop.var_slot];
+                    for (int m = 0; m < 7; m++) f.saved[m + 1] = loop.meta[m] != no_slot ? slots[loop.meta[m]] : nullptr;
+                    if (loop.meta[0] != no_slot) f.index1_value = Value::ref(f.index1);
+                    if (loop.meta[1] != no_slot) f.index0_value = Value::ref(f.index0);
+                    if (loop.meta[4] != no_slot) {
+                        format_index(f.length, size);
+                        f.length_value = Value::ref(f.length);
+                    }
+                    bind_loop(f, slots);
+                    ip++;
+                    break;
+                }
+
+                case OpCode::ForNext: {
+                    LoopFrame& f = frames.back();
+                    if (++f.index < f.size) {
+                        bind_loop(f, slots);
+                        ip = in.b;
+                        break;
+                    }
+                    const Loop& loop = *f.loop;
+                    slots[loop.var_slot] = f.saved[0];
+                    for (int m = 0; m < 7; m++) {
+                        if (loop.meta[m] != no_slot) slots[loop.meta[m]] = f.saved[m + 1];
+                    }
+                    frames.pop_back();
+                    ip++;
+                    break;
+                }
+            }
+        }
+        if (write && !output.empty()) {
+            if (!(*write)(output.data(), output.size())) return false;
+            output.clear();
+        }
+        return true;
+    }
+
+    bool render_to(const Context& context, string& output, const Writer* write) const {
+        auto start = high_resolution_clock::now();
+        log("Rendering with " + to_string(context.vars.size()) + " vars, " + to_string(context.lists.size()) + " lists, " +
+            to_string(context.values.size()) + " values, " + to_string(context.dictionaries.size()) + " dicts");
+
+        bool finished = execute(context, output, write);
+
+        auto end = high_resolution_clock::now();
+        log(string(finished ? "Rendered" : "Rendering stopped by the writer") + " in " +
+            to_string(duration_cast<microseconds>(end - start).count()) + "μs");
+        return finished;
+    }
+
+public:
     // Base64 encode/decode implementations
-    string base64_encode(const string& input) {
+    string base64_encode(const string& input) const {
         static const string base64_chars = 
             "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
             "abcdefghijklmnopqrstuvwxyz"
@@ -1092,7 +1430,7 @@ public:
         return result;
     }
     
-    string base64_decode(const string& input) {
+    string base64_decode(const string& input) const {
         static const string base64_chars = 
             "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
             "abcdefghijklmnopqrstuvwxyz"
@@ -1118,7 +1456,12 @@ public:
     
     Template(const string& html, const string& id = "default") : template_id(id) {
         log("Creating template...");
-        tokens = tokenize(html);
+        vector<Token> tokens = tokenize(html);
+        auto start = high_resolution_clock::now();
+        compile(tokens);
+        auto end = high_resolution_clock::now();
+        log("Compiled " + to_string(code.size()) + " instructions in " +
+            to_string(duration_cast<microseconds>(end - start).count()) + "μs");
     }
     
     // Load template from file
@@ -1161,34 +1504,162 @@ public:
         return *this;
     }
 
+    // Bind a structured value, owned or from Value::ref() (chainable)
+    Template& bind(const string& key, Value value) {
+        values[key] = std::move(value);
+        return *this;
+    }
+
     
     // Clear all variables and lists
     void clear() {
         vars.clear();
         lists.clear();
+        values.clear();
         dictionaries.clear();
     }
     
-    string render() {
-        auto start = high_resolution_clock::now();
-        log("Rendering with " + to_string(vars.size()) + " vars, " + to_string(lists.size()) + " lists, " + to_string(dictionaries.size()) + " dicts");
-        
-        string result = render_internal(tokens, vars, lists);
-        
-        auto end = high_resolution_clock::now();
-        log("Rendered in " + to_string(duration_cast<microseconds>(end - start).count()) + "μs");
-        
+    string render() const {
+        return render(*this);
+    }
+
+    // Rendering only reads the compiled program, so any number of threads
+    // can render one Template at once, each with its own context
+    string render(const Context& context) const {
+        string result;
+        render_to(context, result, nullptr);
         return result;
     }
+
+    bool render(const Writer& write) const {
+        return render(*this, write);
+    }
+
+    // Render in chunks of about chunk_size bytes, handing each to write()
+    // as soon as it is produced, so memory stays bounded however large the
+    // page. Returns false, having stopped early, once write() does; an
+    // httplib chunked content provider can pass sink.write straight in:
+    //     tpl.render(context, [&](const char* d, size_t n) { return sink.write(d, n); })
+    bool render(const Context& context, const Writer& write) const {
+        string buffer;
+        buffer.reserve(chunk_size + chunk_size / 4);
+        return render_to(context, buffer, &write);
+    }
+
+    bool render(ostream& out) const {
+        return render(*this, out);
+    }
+
+    // Render to a stream, chunk by chunk
+    bool render(const Context& context, ostream& out) const {
+        return render(context, [&](const char* data, size_t size) {
+            return bool(out.write(data, size));
+        });
+    }
     
     // Render to file
-    void renderToFile(const string& filepath) {
-        string content = render();
+    void renderToFile(const string& filepath) const {
         ofstream file(filepath);
         if (!file.is_open()) {
             throw runtime_error("Could not write to file: " + filepath);
         }
-        file << content;
+        if (!render(file)) {
+            throw runtime_error("Could not write to file: " + filepath);
+        }
         log("Rendered to file: " + filepath);
     }
 };
+
+// Compiled templates shared by the whole process, keyed by path. A
+// published Template is never modified, so threads render the one get()
+// hands out concurrently, each with its own Context, without locking or
+// re-parsing. A file is recompiled when its modification time changes,
+// checked at most once a second per path. Renders already holding the old
+// compile finish with it; if the file goes missing the last good compile
+// is kept.
+class TemplateRegistry {
+public:
+    using Filter = function<string(const vector<string>&)>;
+
+    static TemplateRegistry& instance() {
+        static TemplateRegistry registry;
+        return registry;
+    }
+
+    // Throws when the file cannot be read and nothing is cached for it
+    shared_ptr<const Template> get(const string& path) {
+        {
+            shared_lock lock(entries_mutex);
+            auto it = entries.find(path);
+            if (it != entries.end()) {
+                Entry& entry = *it->second;
+                // One caller a second looks at the file; the rest take the cached compile
+                int64_t now = steady_clock::now().time_since_epoch().count();
+                int64_t checked = entry.checked.load();
+                if (now - checked < duration_cast<steady_clock::duration>(seconds(1)).count() ||
+                    !entry.checked.compare_exchange_strong(checked, now)) {
+                    return entry.compiled;
+                }
+                error_code ec;
+                auto mtime = filesystem::last_write_time(path, ec);
+                if (ec || mtime == entry.mtime) return entry.compiled;
+            }
+        }
+        return load(path);
+    }
+
+    // A filter for every template, including ones already cached, which
+    // recompile on their next get()
+    void addFilter(const string& name, Filter filter) {
+        unique_lock lock(entries_mutex);
+        filters[name] = std::move(filter);
+        filters_generation++;
+        entries.clear();
+    }
+
+    void clear() {
+        unique_lock lock(entries_mutex);
+        entries.clear();
+    }
+
+private:
+    struct Entry {
+        shared_ptr<const Template> compiled;
+        filesystem::file_time_type mtime;
+        atomic<int64_t> checked;  // steady_clock ticks of the last mtime check
+    };
+
+    shared_mutex entries_mutex;
+    unordered_map<string, unique_ptr<Entry>> entries;
+    unordered_map<string, Filter> filters;
+    uint64_t filters_generation = 0;  // bumped by addFilter
+
+    shared_ptr<const Template> load(const string& path) {
+        // Compile outside the lock; a concurrent load of the same path
+        // does the same work and the later one wins. A compile that missed
+        // an addFilter is redone rather than cached past its clear().
+        error_code ec;
+        auto mtime = filesystem::last_write_time(path, ec);
+        unordered_map<string, Filter> with;
+        uint64_t generation;
+        {
+            shared_lock lock(entries_mutex);
+            with = filters;
+            generation = filters_generation;
+        }
+        auto compiled = make_shared<Template>(Template::fromFile(path));
+        for (auto& [name, filter] : with) compiled->addFilter(name, filter);
+
+        unique_lock lock(entries_mutex);
+        if (generation != filters_generation) {
+            lock.unlock();
+            return load(path);
+        }
+        auto& entry = entries[path];
+        if (!entry) entry = make_unique<Entry>();
+        entry->compiled = compiled;
+        entry->mtime = mtime;
+        entry->checked = steady_clock::now().time_since_epoch().count();
+        return compiled;
+    }
+};
@@ -0,0 +1,105 @@
+#!/bin/sh
+# HTTP checks against a running server. Usage: api_test.sh PATH_TO_VOCALO
+# Starts the binary on a spare port with an empty data directory.
+set -u
+bin=$1
+port=$((20000 + $$ % 10000))
+data=$(mktemp -d)
+XDG_DATA_HOME=$data "$bin" --no-browser --port $port > "$data/server.log" 2>&1 &
+pid=$!
+trap 'kill $pid 2>/dev/null; rm -rf "$data"' EXIT
+url=http://localhost:$port
+i=0
+until curl -s -o /dev/null $url/api/decks; do
+    i=$((i + 1))
+    [ $i -gt 50 ] && { echo "server did not start"; exit 1; }
+    sleep 0.1
+done
+
+failures=0
+# expect METHOD PATH BODY STATUS [SUBSTRING]
+expect() {
+    out=$(curl -s -m 5 -X "$1" -w '\n%{http_code}' -d "$3" "$url$2")
+    status=$(printf '%s' "$out" | tail -n 1)
+    body=$(printf '%s' "$out" | sed '$d')
+    if [ "$status" != "$4" ] || { [ $# -ge 5 ] && ! printf '%s' "$body" | grep -qF -- "$5"; }; then
+        echo "$1 $2 $3: got $status $body, want $4 ${5:-}"
+        failures=$((failures + 1))
+    fi
+}
+
+# Malformed or mistyped bodies are rejected, not spun on or saved empty
+expect POST /api/save-deck '{"id":"x","name":"y","words":[}]}' 400
+expect POST /api/save-deck '[]' 400
+expect POST /api/save-session '"text"' 400
+expect POST /api/save-session '[1]' 400
+expect DELETE /api/delete-deck '7' 400
+expect POST /api/check-answer 'null' 400
+expect POST /api/review '[]' 400
+expect POST /api/reviews '[}' 400
+expect POST /api/reviews '{}' 400
+expect GET /api/sessions '' 200 '[]'
+
+# A batch with a stale card is refused whole, naming the stale ones
+expect POST /api/save-deck '{"id":"d1","name":"One","words":[{"word":"a","translation":"x"},{"word":"b","translation":"y"}]}' 200
+expect POST /api/reviews '[{"deck":"d1","word":0,"rating":2,"time":1000},{"deck":"d1","word":9,"rating":2}]' 409 '"rejected":[1]'
+expect GET '/api/next-cards?deck=d1' '' 200 '"due":0,"cards":[{"id":0,'
+expect POST /api/reviews '[{"deck":"d1","word":0,"rating":2,"time":1000}]' 200 '"applied":1'
+expect POST /api/review '{"deck":"gone","word":0,"rating":2}' 400
+
+# Positions from next-cards that went stale after an edit are found by text
+expect POST /api/save-deck '{"id":"d2","name":"Two","words":[{"word":"p"},{"word":"q"}]}' 200
+expect POST /api/reviews '[{"deck":"d2","word":0,"text":"q","rating":2},{"deck":"d2","word":0,"text":"gone","rating":2}]' 409 '"rejected":[1]'
+expect POST /api/reviews '[{"deck":"d2","word":0,"text":"q","rating":2}]' 200 '"applied":1'
+expect GET '/api/next-cards?deck=d2' '' 200 '"cards":[{"id":0,"word":"p"'
+
+# An empty page would hand back its own cursor and loop clients forever
+expect GET '/api/deck-words?id=d1&limit=0' '' 200 '"next":1,'
+expect GET '/api/deck-words?id=d1&cursor=1&limit=0' '' 200 '"next":null'
+expect POST /api/save-session '{"deck":"d1","mode":"quiz","correct":1,"total":2,"score":3}' 200
+expect POST /api/save-session '{"deck":"d1","mode":"quiz","correct":2,"total":2,"score":6}' 200
+expect GET '/api/sessions?limit=0' '' 200 '"correct":1,'
+
+# If-None-Match is a list of tags compared weakly, but each one exactly
+tag=$(curl -s -D - -o /dev/null $url/api/decks | sed -n 's/^etag: *//Ip' | tr -d '\r')
+expect_inm() {
+    status=$(curl -s -o /dev/null -w '%{http_code}' -H "If-None-Match: $1" $url/api/decks)
+    if [ "$status" != "$2" ]; then
+        echo "GET /api/decks If-None-Match: $1: got $status, want $2"
+        failures=$((failures + 1))
+    fi
+}
+expect_inm "$tag" 304
+expect_inm "\"x\", W/$tag" 304
+expect_inm '*' 304
+expect_inm "\"x$(echo "$tag" | tr -d '"')\"" 200
+expect_inm "\"x\", \"y\"" 200
+expect_inm "\"x$tag\"" 200
+
+# A change whose journal write fails answers 500 and is not served either;
+# a directory in the journal's place makes every write to it fail. Clock
+# readings ("now") are left out of the comparison.
+get_state() { curl -s "$url$1" | sed 's/"now":[0-9]*,//'; }
+expect_same() {
+    now=$(get_state "$1")
+    if [ "$now" != "$2" ]; then
+        echo "GET $1 changed after a failed write: $now"
+        failures=$((failures + 1))
+    fi
+}
+decks=$(get_state /api/decks)
+cards=$(get_state "/api/next-cards?deck=d1")
+rm -f "$data/vocalo/decks.journal" "$data/vocalo/reviews.journal"
+mkdir "$data/vocalo/decks.journal" "$data/vocalo/reviews.journal"
+expect POST /api/save-deck '{"id":"d3","name":"Three","words":[{"word":"z"}]}' 500
+expect POST /api/save-deck '{"id":"d1","name":"Renamed","words":[{"word":"a"}]}' 500
+expect DELETE /api/delete-deck '{"id":"d2"}' 500
+expect POST /api/reviews '[{"deck":"d1","word":1,"text":"b","rating":3}]' 500
+expect_same /api/decks "$decks"
+expect_same "/api/next-cards?deck=d1" "$cards"
+rmdir "$data/vocalo/decks.journal" "$data/vocalo/reviews.journal"
+expect POST /api/save-deck '{"id":"d3","name":"Three","words":[{"word":"z"}]}' 200
+expect GET /api/decks '' 200 '"d3"'
+
+[ $failures -eq 0 ] && echo ok || echo FAILED
+[ $failures -eq 0 ]
@@ -0,0 +1,76 @@
+// Checks that decks loaded from decks.bin read their words out of the
+// mapping, and that those words stay valid after the deck is replaced and
+// the file rewritten. Build and run from the repository root:
+//   g++ -std=c++17 -O1 -DVOCALO_NO_MAIN tests/binary_store_test.cpp -o binary_store_test -lpthread && ./binary_store_test
+#include "../main.cpp"
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            cout << __FILE__ << ":" << __LINE__ << ": CHECK(" #cond ") failed\n"; \
+            failures++; \
+        } \
+    } while (0)
+
+static Deck make_deck(const string& name, const vector<WordFields>& words) {
+    Deck d;
+    d.name = name;
+    pack_words(d, words);
+    return d;
+}
+
+int main() {
+    fs::path dir = fs::temp_directory_path() / ("vocalo_binary_store_test_" + to_string(getpid()));
+    fs::create_directories(dir);
+    Tenant t;
+    t.dir = dir;
+    t.decks["a"] = make_deck("A", {{"uno", "one", "", "", ""}, {"dos", "two", "", "", "hint"}});
+    t.decks["b"] = make_deck("B", {{"tres", "three", "a number", "Tengo tres", ""}, {"", "", "", "", ""}});
+    CHECK(save_decks_binary(t));
+
+    Tenant loaded;
+    loaded.dir = dir;
+    CHECK(load_decks_binary(loaded));
+    CHECK(loaded.decks.size() == 2);
+    const Deck& a = loaded.decks["a"];
+    CHECK(a.name == "A");
+    CHECK(a.words.size() == 2);
+    CHECK(a.words[1].word == "dos" && a.words[1].hint == "hint");
+    CHECK(a.text && a.text_bytes == 0);
+    const Deck& b = loaded.decks["b"];
+    CHECK(b.words.size() == 2 && b.words[0].example == "Tengo tres" && b.words[1].word.empty());
+
+    // Replacing a deck and rewriting the file leaves copies of the old deck
+    // reading the old mapping
+    Deck before = a;
+    loaded.decks["a"] = make_deck("A", {{"cuatro", "four", "", "", ""}});
+    CHECK(save_decks_binary(loaded));
+    CHECK(before.words[0].word == "uno" && before.words[1].translation == "two");
+    CHECK(loaded.decks["b"].words[0].definition == "a number");
+
+    Tenant reloaded;
+    reloaded.dir = dir;
+    CHECK(load_decks_binary(reloaded));
+    CHECK(reloaded.decks["a"].words.size() == 1 && reloaded.decks["a"].words[0].word == "cuatro");
+
+    // A string reference past the end of the string table is refused whole
+    string content;
+    CHECK(read_whole_file(get_decks_bin_file(t), content));
+    size_t word0 = sizeof(BinHeader) + 2 * sizeof(BinDeck);
+    BinWord bw;
+    memcpy(&bw, content.data() + word0, sizeof(bw));
+    bw.word.off = (uint32_t)content.size();
+    memcpy(&content[word0], &bw, sizeof(bw));
+    CHECK(write_file_atomic(get_decks_bin_file(t), content));
+    Tenant corrupt;
+    corrupt.dir = dir;
+    CHECK(!load_decks_binary(corrupt));
+    CHECK(corrupt.decks.empty());
+
+    error_code ec;
+    fs::remove_all(dir, ec);
+    cout << (failures ? "FAILED" : "ok") << "\n";
+    return failures ? 1 : 0;
+}
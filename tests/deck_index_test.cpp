@@ -0,0 +1,72 @@
+// Checks that the search and duplicate indexes, built outside the deck
+// lock, still see decks saved during the build. Build and run from the
+// repository root:
+//   g++ -std=c++17 -O1 -DVOCALO_NO_MAIN tests/deck_index_test.cpp -o deck_index_test -lpthread && ./deck_index_test
+#include "../main.cpp"
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            cout << __FILE__ << ":" << __LINE__ << ": CHECK(" #cond ") failed\n"; \
+            failures++; \
+        } \
+    } while (0)
+
+static Deck make_deck(const string& prefix, size_t n) {
+    Deck d;
+    d.name = prefix;
+    vector<WordFields> words;
+    for (size_t i = 0; i < n; i++) words.push_back({prefix + to_string(i), "t" + prefix + to_string(i), "", "", ""});
+    pack_words(d, words);
+    return d;
+}
+
+static bool finds(Tenant& t, const string& q) {
+    shared_lock lock(t.decks_mutex);
+    for (const auto& h : t.search.search(q, 5)) {
+        if (h.rank == 0) return true;
+    }
+    return false;
+}
+
+int main() {
+    fs::path dir = fs::temp_directory_path() / ("vocalo_deck_index_test_" + to_string(getpid()));
+    fs::create_directories(dir);
+    Tenant t;
+    t.dir = dir;
+    t.deck_journal.open(get_deck_journal_file(t));
+    for (int i = 0; i < 20; i++) t.decks["bulk" + to_string(i)] = make_deck("bulk" + to_string(i) + "w", 5000);
+    t.decks["small"] = make_deck("oldword", 3);
+    t.decks["gone"] = make_deck("goneword", 3);
+    rebuild_decks_snapshot(t);
+
+    // Saves and deletes race the first search's build; the duplicate index
+    // is ready so that they are quick
+    build_deck_index(t, t.duplicates, t.duplicate_bytes, t.duplicates_build_mutex);
+    thread writer([&] {
+        string json;
+        save_deck(t, "small", make_deck("newword", 3), json);
+        save_deck(t, "added", make_deck("addedword", 3), json);
+        unique_lock lock(t.decks_mutex);
+        t.decks.erase("gone");
+        if (t.search.built()) t.search.remove_deck("gone");
+        rebuild_decks_snapshot(t);
+    });
+    build_deck_index(t, t.search, t.search_bytes, t.search_build_mutex);
+    writer.join();
+
+    CHECK(finds(t, "newword1"));
+    CHECK(finds(t, "addedword2"));
+    CHECK(!finds(t, "oldword1"));
+    CHECK(!finds(t, "goneword1"));
+    CHECK(finds(t, "bulk3w42"));
+    CHECK(t.duplicates.built());
+    CHECK(t.search_bytes > 0);
+
+    error_code ec;
+    fs::remove_all(dir, ec);
+    cout << (failures ? "FAILED" : "ok") << "\n";
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,75 @@
+// Checks for GroupCommitLog error reporting and journal replay. Build and
+// run from the repository root:
+//   g++ -std=c++17 -O1 -DVOCALO_NO_MAIN tests/journal_test.cpp -o journal_test -lpthread && ./journal_test
+#include "../main.cpp"
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            cout << __FILE__ << ":" << __LINE__ << ": CHECK(" #cond ") failed\n"; \
+            failures++; \
+        } \
+    } while (0)
+
+static fs::path scratch() {
+    fs::path dir = fs::temp_directory_path() / ("vocalo_journal_test_" + to_string(getpid()));
+    fs::create_directories(dir);
+    return dir;
+}
+
+static void writes_are_acknowledged() {
+    fs::path path = scratch() / "ok.journal";
+    fs::remove(path);
+    {
+        GroupCommitLog log;
+        log.open(path);
+        CHECK(log.wait_durable(log.append("one\n")));
+        CHECK(log.wait_durable(log.append("two\n")));
+    }
+    string content;
+    CHECK(read_whole_file(path, content) && content == "one\ntwo\n");
+}
+
+// /dev/full accepts the open and fails every write
+static void failed_writes_are_reported() {
+#ifdef __linux__
+    GroupCommitLog log;
+    log.open("/dev/full");
+    CHECK(!log.wait_durable(log.append("lost\n")));
+    CHECK(!log.wait_durable(log.append("lost too\n")));
+#endif
+}
+
+// Appends after a missing file must not be acknowledged
+static void missing_directory_is_reported() {
+    GroupCommitLog log;
+    log.open(scratch() / "no such dir" / "x.journal");
+    CHECK(!log.wait_durable(log.append("lost\n")));
+}
+
+static void replay_skips_damaged_lines() {
+    fs::path path = scratch() / "torn.journal";
+    CHECK(write_file_atomic(path, "a\nbroken\nb\nhalf"));
+    string seen;
+    size_t applied = replay_journal(path, [&](string_view line) {
+        if (line == "broken") return false;
+        seen += line;
+        return true;
+    });
+    CHECK(applied == 2 && seen == "ab");
+    string content;
+    CHECK(read_whole_file(path, content) && content == "a\nbroken\nb\n");
+}
+
+int main() {
+    writes_are_acknowledged();
+    failed_writes_are_reported();
+    missing_directory_is_reported();
+    replay_skips_damaged_lines();
+    error_code ec;
+    fs::remove_all(scratch(), ec);
+    cout << (failures ? "FAILED" : "ok") << "\n";
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,87 @@
+// Unit checks for JsonReader. Build and run from the repository root:
+//   g++ -std=c++17 -O1 -DVOCALO_NO_MAIN tests/json_reader_test.cpp -o json_reader_test -lpthread && ./json_reader_test
+#include "../main.cpp"
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            cout << __FILE__ << ":" << __LINE__ << ": CHECK(" #cond ") failed\n"; \
+            failures++; \
+        } \
+    } while (0)
+
+// Walks an array skipping every element, as the deck and review readers
+// do; gives up after a bound so a regression fails instead of hanging
+static bool skips_array(const string& json, size_t& steps) {
+    JsonReader r(json);
+    steps = 0;
+    if (!r.begin_array()) return false;
+    string_view key;
+    while (r.next_element() && steps < 1000) {
+        if (r.begin_object()) {
+            while (r.next_key(key)) r.skip_value();
+        } else {
+            r.skip_value();
+        }
+        steps++;
+    }
+    return r.ok();
+}
+
+static void malformed_arrays_terminate() {
+    size_t steps;
+    for (const char* json : {"[}", "[:]", "[1,,2]", "[1 2 }", "[", "[\"a\"", "[{\"a\":1},]"}) {
+        skips_array(json, steps);
+        CHECK(steps < 1000);
+    }
+    CHECK(!skips_array("[}", steps));
+    CHECK(skips_array("[1, \"two\", [3], {\"four\": 4}, null]", steps) && steps == 5);
+}
+
+static void nested_words_terminate() {
+    // The shape read_words() walks: {"words":[...]}
+    JsonReader r("{\"words\":[}]}");
+    CHECK(r.begin_object());
+    string_view key;
+    size_t steps = 0;
+    while (r.next_key(key) && steps < 1000) {
+        if (key == "words" && r.begin_array()) {
+            while (r.next_element() && steps < 1000) {
+                if (!r.begin_object()) r.skip_value();
+                steps++;
+            }
+        } else {
+            r.skip_value();
+        }
+        steps++;
+    }
+    CHECK(steps < 1000);
+    CHECK(!r.ok());
+}
+
+static void scalars() {
+    JsonReader r("{\"n\": -12.5e3, \"s\": \"a\\u00e9\", \"b\": true}");
+    CHECK(r.begin_object());
+    string_view key;
+    long long n = 0;
+    string str;
+    CHECK(r.next_key(key) && key == "n" && r.read_int(n) && n == -12);
+    CHECK(r.next_key(key) && key == "s" && r.read_string(str) && str == "a\xc3\xa9");
+    CHECK(r.next_key(key) && key == "b");
+    r.skip_value();
+    CHECK(!r.next_key(key) && r.ok());
+
+    JsonReader missing("{\"a\":}");
+    CHECK(missing.begin_object() && missing.next_key(key));
+    CHECK(!missing.read_int(n) && !missing.ok());
+}
+
+int main() {
+    malformed_arrays_terminate();
+    nested_words_terminate();
+    scalars();
+    cout << (failures ? "FAILED" : "ok") << "\n";
+    return failures ? 1 : 0;
+}
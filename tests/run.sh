@@ -0,0 +1,24 @@
+#!/bin/sh
+# Builds and runs every tests/*_test.cpp, which include main.cpp with
+# -DVOCALO_NO_MAIN, then runs every tests/*_test.sh against a build of the
+# server. Each exits non-zero on failure.
+set -e
+cd "$(dirname "$0")/.."
+mkdir -p build/tests
+status=0
+for src in tests/*_test.cpp; do
+    name=$(basename "$src" .cpp)
+    g++ -std=c++17 -O1 -g -DVOCALO_NO_MAIN "$src" -o "build/tests/$name" -lpthread
+    printf '%s: ' "$name"
+    if ! (cd build/tests && timeout 120 "./$name"); then
+        status=1
+    fi
+done
+g++ -std=c++17 -O1 -g main.cpp -o build/tests/vocalo -lpthread
+for script in tests/*_test.sh; do
+    printf '%s: ' "$(basename "$script" .sh)"
+    if ! sh "$script" "$PWD/build/tests/vocalo"; then
+        status=1
+    fi
+done
+exit $status
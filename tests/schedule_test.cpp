@@ -0,0 +1,55 @@
+// Checks DeckSchedule's new-card bitmap against a plain scan. Build and
+// run from the repository root:
+//   g++ -std=c++17 -O1 -DVOCALO_NO_MAIN tests/schedule_test.cpp -o schedule_test -lpthread && ./schedule_test
+#include "../main.cpp"
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            cout << __FILE__ << ":" << __LINE__ << ": CHECK(" #cond ") failed\n"; \
+            failures++; \
+        } \
+    } while (0)
+
+static vector<uint32_t> scan_new(const DeckSchedule& s, size_t n) {
+    vector<uint32_t> out;
+    for (uint32_t id = 0; id < s.cards.size() && out.size() < n; id++) {
+        if (!s.cards[id].due) out.push_back(id);
+    }
+    return out;
+}
+
+// Reviews cards in random order, across the 64 and 4096 boundaries of
+// the bitmap, comparing new_cards() with a scan after every step
+static void new_cards_match_scan() {
+    mt19937 rng(7);
+    for (size_t size : {0, 1, 63, 64, 65, 4095, 4096, 4097, 10000}) {
+        vector<CardState> states(size);
+        for (auto& c : states) {
+            if (rng() % 3 == 0) c.due = 1 + rng() % 1000;
+        }
+        DeckSchedule s;
+        s.assign(states);
+        for (int step = 0; step < 300; step++) {
+            size_t n = rng() % 100;
+            vector<uint32_t> got;
+            s.new_cards(n, got);
+            CHECK(got == scan_new(s, n));
+            if (size == 0) break;
+            uint32_t id = rng() % size;
+            apply_review(s.cards[id], rng() % 4, 1000 + step);
+            s.updated(id);
+        }
+        vector<uint32_t> all;
+        s.new_cards(SIZE_MAX, all);
+        CHECK(all == scan_new(s, SIZE_MAX));
+    }
+}
+
+int main() {
+    new_cards_match_scan();
+    cout << (failures ? "FAILED" : "ok") << "\n";
+    return failures ? 1 : 0;
+}
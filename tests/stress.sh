@@ -0,0 +1,61 @@
+#!/bin/sh
+# Concurrency stress under ThreadSanitizer: builds the server with
+# -fsanitize=thread, drives concurrent deck, review, session, search and
+# import traffic for several users at it, and fails on any race report.
+# Slow, so not part of run.sh. Usage: tests/stress.sh [ROUNDS]
+set -u
+cd "$(dirname "$0")/.."
+rounds=${1:-10}
+mkdir -p build/tests
+g++ -std=c++17 -O1 -g -fsanitize=thread main.cpp -o build/tests/vocalo-tsan -lpthread || exit 1
+
+port=$((20000 + $$ % 10000))
+data=$(mktemp -d)
+TSAN_OPTIONS="halt_on_error=0 second_deadlock_stack=1" XDG_DATA_HOME=$data \
+    build/tests/vocalo-tsan --no-browser --port $port --memory-budget 1 > "$data/server.log" 2>&1 &
+pid=$!
+trap 'kill $pid 2>/dev/null; rm -rf "$data"' EXIT
+url=http://localhost:$port
+i=0
+until curl -s -o /dev/null $url/api/decks; do
+    i=$((i + 1))
+    [ $i -gt 100 ] && { echo "server did not start"; cat "$data/server.log"; exit 1; }
+    sleep 0.1
+done
+
+# One client: its own deck in a user shared with other clients, so decks,
+# schedules and sessions are read and written from several threads at once
+client() {
+    n=$1
+    for j in $(seq 1 $rounds); do
+        u="user=u$(( (n * j) % 5 ))"
+        curl -s -o /dev/null -XPOST -d "{\"id\":\"deck_$n\",\"name\":\"N$j\",\"words\":[{\"word\":\"w$j\",\"translation\":\"t\"},{\"word\":\"x$n\"}]}" "$url/api/save-deck?$u"
+        curl -s -o /dev/null "$url/api/decks?$u"
+        curl -s -o /dev/null "$url/api/deck-list?$u"
+        curl -s -o /dev/null "$url/api/deck-words?$u&id=deck_$n&limit=1"
+        curl -s -o /dev/null "$url/api/next-cards?$u&deck=deck_$n"
+        curl -s -o /dev/null -XPOST -d "[{\"deck\":\"deck_$n\",\"word\":1,\"rating\":2},{\"deck\":\"deck_$n\",\"word\":0,\"rating\":0}]" "$url/api/reviews?$u"
+        curl -s -o /dev/null -XPOST -d '{"deck":"x","correct":1,"total":2,"score":3,"mode":"quiz"}' "$url/api/save-session?$u"
+        curl -s -o /dev/null "$url/api/sessions?$u&limit=5"
+        curl -s -o /dev/null "$url/api/stats?$u"
+        curl -s -o /dev/null "$url/api/search?$u&q=w$j"
+        curl -s -o /dev/null -XPOST -d '{"answer":"w1","expected":"w1"}' "$url/api/check-answer?$u"
+        printf 'a%s\tb\nc%s\td\n' $j $n | curl -s -o /dev/null -XPOST --data-binary @- "$url/api/import?$u&id=imp_$n&name=I&format=tsv"
+        [ $((j % 7)) = 0 ] && curl -s -o /dev/null -XDELETE -d "{\"id\":\"deck_$n\"}" "$url/api/delete-deck?$u"
+    done
+}
+clients=
+for n in 1 2 3 4 5 6 7 8; do
+    client $n &
+    clients="$clients $!"
+done
+wait $clients
+
+kill $pid
+wait $pid 2>/dev/null
+if grep -q "ThreadSanitizer" "$data/server.log"; then
+    cat "$data/server.log"
+    echo FAILED
+    exit 1
+fi
+echo ok